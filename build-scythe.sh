@@ -1,7 +1,7 @@
 #!/usr/bin/sh
 
 # paths... hardcoded for now
-SDL2=../../SDL2-2.0.14/i686-w64-mingw32
+SDL2=../../SDL2-2.0.20/i686-w64-mingw32
 INCLUDE="-I${SDL2}/include"
 LIB="-L${SDL2}/lib"
 # FLAGS="-Wl,-subsystem,windows" # gets rid of the console window
@@ -19,5 +19,11 @@ cp $SDLBIN/SDL2_image.dll out/
 cp $SDLBIN/libpng16-16.dll out/
 cp $SDLBIN/zlib1.dll out/
 
-g++ -c -o out/common.o src/common.cpp ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
-g++ -o out/scythe out/common.o src/scythe.cpp ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
+# the kernel owns the renderer, so it builds the render backends too
+mkdir -p out/kernel
+OBJS=""
+for src in common vec color damage render render_sdl render_soft textureManager atlas inputLog serialize reloadState fileWatcher buildProcess; do
+    g++ -c -o out/kernel/${src}.o src/${src}.cpp ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
+    OBJS="${OBJS} out/kernel/${src}.o"
+done
+g++ -o out/scythe ${OBJS} src/scythe.cpp ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
@@ -1,17 +1,44 @@
+import concurrent.futures
+import ctypes
+import ctypes.util
+import json
 import os
 import pprint
+import select
 import shutil
+import struct
+import subprocess
 import sys
 import time
 
-SDL2_PATH = os.path.join('..', '..', 'SDL2-2.0.14', 'i686-w64-mingw32')
-INCLUDE='-I{}/include'.format(SDL2_PATH)
-LIB='-L{}/lib'.format(SDL2_PATH)
-FLAGS=''
-LINK='-lmingw32 -lSDL2main -lSDL2 -lSDL2_image'
+WINDOWS = sys.platform == 'win32'
+if WINDOWS:
+    SDL2_PATH = os.path.join('..', '..', 'SDL2-2.0.20', 'i686-w64-mingw32')
+    INCLUDE='-I{}/include'.format(SDL2_PATH)
+    LIB='-L{}/lib'.format(SDL2_PATH)
+    FLAGS=''
+    LINK='-lmingw32 -lSDL2main -lSDL2 -lSDL2_image'
+    GAME_LIB='game.dll'
+    GAME_LINK_FLAGS=''
+else:
+    # SDL from the system's packages
+    INCLUDE=''
+    LIB=''
+    # objs go into game.so, so have to be position-independent
+    FLAGS='-fPIC'
+    LINK='-lSDL2 -lSDL2_image -ldl'
+    GAME_LIB='game.so'
+    # dlopen'd libraries look up their own calls through the global scope
+    # first, where libstdc++'s operator new wins over the profiler's counting
+    # one; bind them to the library's own definitions instead
+    GAME_LINK_FLAGS='-Wl,-Bsymbolic-functions'
 DBG_FLAGS='-fdiagnostics-color=always -g'
+BENCH_FLAGS='-fdiagnostics-color=always -O2'
 
-LOCKFILE='out/game.dll.lock'
+# how many objs to compile at once
+JOBS = os.cpu_count() or 1
+# how long each obj took to compile last time, so the slow ones start first
+BUILD_TIMES = os.path.join('out', 'build-times.json')
 
 # console colors enum
 class Color(object):
@@ -73,18 +100,10 @@ def Program(name):
 def ensure_outdir():
     os.makedirs('./out', exist_ok=True)
 
-def create_lock():
-    with open(LOCKFILE, 'w') as file:
-        pass
-
-def release_lock():
-    try:
-        os.remove(LOCKFILE)
-    except Exception as e:
-        pass
-
 def copy_dlls():
     """Copies third-party SDL .dll files from SDL2_PATH"""
+    if not WINDOWS:
+        return
     sdlbin = os.path.join(SDL2_PATH, 'bin')
     dlls = [
         'SDL2.dll',
@@ -95,51 +114,119 @@ def copy_dlls():
     for dll in dlls:
         shutil.copy(os.path.join(sdlbin, dll), 'out')
 
+def time_color(elapsed):
+    if elapsed > 5.0:
+        return Color.ERR
+    if elapsed > 2.0:
+        return Color.WARN
+    return Color.OK
+
 def run_cmd(cmd):
     start = time.time()
     # os.system outputs go to the same terminal, so flush any pending prints first
     sys.stdout.flush()
 
-    # critical section
-    create_lock()
     code = os.system(cmd)
-    release_lock()
 
     # logging
     elapsed = time.time()-start
 
     color = Color.OK if code == 0 else Color.ERR
-    time_color = Color.OK
-    if elapsed > 2.0:
-        time_color = Color.WARN
-    if elapsed > 5.0:
-        time_color = Color.ERR
     log(color, 'cmd finished in {}{:.2f}{}s : {}'.format(
-        time_color, elapsed, Color.DEFAULT, cmd
+        time_color(elapsed), elapsed, Color.DEFAULT, cmd
     ))
     if code != 0:
         logh('Error', Color.ERR, 'exited with code={}'.format(code))
     return code == 0
 
-def build_obj(cpp, obj):
-    flags = ' '.join([INCLUDE, LIB, FLAGS, LINK, DBG_FLAGS])
-    log(Color.INFO, 'building {}...'.format(obj))
-    return run_cmd('g++ -c -o {} {} {}'.format(obj, cpp, flags))
+def load_build_times() -> dict[str, float]:
+    try:
+        with open(BUILD_TIMES) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+def build_objs(objs: list[tuple[str, str]], opt_flags=DBG_FLAGS) -> bool:
+    """Compiles each (cpp, obj), JOBS at a time. The ones that took longest
+    last time go first, so the last to finish is a short one, and whatever
+    links them can start sooner. Each compile's output is printed in one
+    piece as it finishes, so errors don't interleave. Returns False if any
+    failed, once they've all finished"""
+    if not objs:
+        return True
+    flags = ' '.join([INCLUDE, LIB, FLAGS, LINK, opt_flags])
+    times = load_build_times()
+    objs = sorted(objs, key=lambda o: times.get(o[1], 0), reverse=True)
+    jobs = min(JOBS, len(objs))
+    log(Color.INFO, 'building {} objs, {} at a time...'.format(len(objs), jobs))
+    sys.stdout.flush()
+
+    def compile_obj(cpp, obj):
+        start = time.time()
+        cmd = 'g++ -c -o {} {} {}'.format(obj, cpp, flags)
+        result = subprocess.run(cmd, shell=True,
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        return obj, cmd, result, time.time() - start
+
+    start = time.time()
+    ok = True
+    elapsed = {}
+    built = {} # failures stop early, so their times would mislead the order
+    with concurrent.futures.ThreadPoolExecutor(jobs) as pool:
+        futures = [pool.submit(compile_obj, cpp, obj) for cpp, obj in objs]
+        for future in concurrent.futures.as_completed(futures):
+            obj, cmd, result, dt = future.result()
+            elapsed[obj] = dt
+            if result.stdout:
+                sys.stdout.write(result.stdout.decode(errors='replace'))
+            if result.returncode == 0:
+                built[obj] = dt
+                log(Color.OK, 'built {} in {}{:.2f}{}s'.format(
+                    obj, time_color(dt), dt, Color.DEFAULT))
+            else:
+                ok = False
+                logh('Error', Color.ERR, 'exited with code={} : {}'.format(
+                    result.returncode, cmd))
+            sys.stdout.flush()
+    wall = time.time() - start
+
+    times.update(built)
+    with open(BUILD_TIMES, 'w') as f:
+        json.dump(times, f, indent=1)
+
+    # the slowest translation units are where build time goes
+    slowest = sorted(elapsed.items(), key=lambda t: t[1], reverse=True)
+    log(Color.INFO, 'compiled in {:.2f}s, {:.2f}s of compiler time; slowest:'.format(
+        wall, sum(elapsed.values())))
+    for obj, dt in slowest[:5]:
+        log(Color.INFO, '  {}{:6.2f}{}s {}'.format(
+            time_color(dt), dt, Color.DEFAULT, obj))
+    return ok
 
 def build_scythe():
-    if not build_obj('src/common.cpp', 'out/common.o'):
+    # the kernel shares some sources with game.dll (e.g. render.cpp), so its
+    # objs live separately, to not race with a running watch build
+    outdir = os.path.join('out', 'kernel')
+    os.makedirs(outdir, exist_ok=True)
+    build = BuildTree('scythe')
+    to_build = [(cpp, cpp_to_obj(cpp, outdir)) for cpp, _ in build.objs
+        if cpp != os.path.join('src', 'scythe.cpp')]
+    if not build_objs(to_build):
         return False
+    objs = [obj for _, obj in to_build]
     flags = ' '.join([INCLUDE, LIB, FLAGS, LINK, DBG_FLAGS])
     log(Color.INFO, 'building scythe...')
     sys.stdout.flush()
-    if os.system('g++ -o out/scythe out/common.o src/scythe.cpp ' + flags) != 0:
+    cmd = 'g++ -o out/scythe {} src/scythe.cpp {}'.format(' '.join(objs), flags)
+    if os.system(cmd) != 0:
         log(Color.ERR, '  error building scythe')
         return False
     log(Color.OK, '  build successful')
     return True
 
 @Program('run')
-def build_and_run():
+def build_and_run(*args):
+    """Any args are passed along to scythe, e.g. --headless --frames 600"""
     ensure_outdir()
     copy_dlls()
     if not build_scythe():
@@ -147,14 +234,14 @@ def build_and_run():
 
     # run
     os.chdir('out')
-    os.system('scythe')
+    os.system(' '.join([os.path.join('.', 'scythe')] + list(args)))
     return 0
 
-def cpp_to_obj(cpp: str) -> str:
+def cpp_to_obj(cpp: str, outdir: str = 'out') -> str:
     """the name of the .o file for a given .cpp file"""
     assert cpp.startswith('src')
     assert cpp.endswith('.cpp')
-    return 'out'+cpp[3:-3]+'o'
+    return outdir+cpp[3:-3]+'o'
 
 class BuildTree(object):
     def __init__(self, root_name):
@@ -201,22 +288,117 @@ class BuildTree(object):
                 deps.add(rec)
         return deps
 
-class ChangeWatcher(object):
-    def __init__(self, src_files):
-        self.src_files = src_files
-        self.modified = {}
-        for file in self.src_files:
-            self.modified[file] = os.path.getmtime(file)
+class Inotify(object):
+    """Just enough of inotify, through ctypes, to wait on directories"""
+    # from <sys/inotify.h>
+    IN_CLOSE_WRITE = 0x8
+    IN_MOVED_TO = 0x80
+    IN_CREATE = 0x100
+    IN_CLOEXEC = 0o2000000
+    EVENT = struct.Struct('iIII') # wd, mask, cookie, len; then the name
+
+    def __init__(self):
+        libc = ctypes.CDLL(ctypes.util.find_library('c'), use_errno=True)
+        self.add_watch_fn = libc.inotify_add_watch
+        self.add_watch_fn.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_uint32]
+        self.fd = libc.inotify_init1(Inotify.IN_CLOEXEC)
+        if self.fd < 0:
+            raise OSError(ctypes.get_errno(), 'inotify_init1 failed')
+        self.dirs = {} # wd -> path
+
+    def add_watch(self, path: str):
+        if path in self.dirs.values():
+            return
+        mask = Inotify.IN_CLOSE_WRITE | Inotify.IN_MOVED_TO | Inotify.IN_CREATE
+        wd = self.add_watch_fn(self.fd, path.encode(), mask)
+        if wd < 0:
+            raise OSError(ctypes.get_errno(), 'could not watch ' + path)
+        self.dirs[wd] = path
+
+    def read(self, timeout=None) -> set[str]:
+        """Blocks until something happens, or `timeout` seconds pass
+        Returns the paths of files written to"""
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if not ready:
+            return set()
+        data = os.read(self.fd, 64 * 1024)
+        paths = set()
+        offset = 0
+        while offset < len(data):
+            wd, mask, cookie, size = Inotify.EVENT.unpack_from(data, offset)
+            offset += Inotify.EVENT.size
+            name = data[offset:offset+size].rstrip(b'\0').decode()
+            offset += size
+            if wd in self.dirs and name:
+                paths.add(os.path.join(self.dirs[wd], name))
+        return paths
+
+def try_inotify():
+    try:
+        return Inotify()
+    except (AttributeError, OSError, TypeError):
+        # not Linux, or no inotify for whatever reason
+        return None
 
-    def find_changes(self):
+class ChangeWatcher(object):
+    """Finds which files changed. With inotify, `wait_for_changes` sleeps until
+    there are some, so it costs nothing while idle and wakes up as soon as a
+    file's written; without, it checks modification times every 100ms"""
+    POLL_INTERVAL = 0.1
+
+    def __init__(self, src_files, modified=None):
+        self.inotify = try_inotify()
+        self.modified = dict(modified or {})
+        self.src_files = []
+        self.watch(src_files)
+
+    def watch(self, files):
+        """Adds files to watch, if they aren't already"""
+        for file in files:
+            if file in self.src_files:
+                continue
+            self.src_files.append(file)
+            if file not in self.modified:
+                self.modified[file] = os.path.getmtime(file)
+            if self.inotify:
+                self.inotify.add_watch(os.path.dirname(file) or '.')
+
+    def find_changes(self, candidates=None):
+        """Of the watched files (or just `candidates`), the ones that were
+        modified since last time"""
         changed = set()
-        for file in self.src_files:
+        for file in (self.src_files if candidates is None else candidates):
+            if file not in self.modified or not os.path.exists(file):
+                continue
             mod = os.path.getmtime(file)
             if mod > self.modified[file]:
                 self.modified[file] = mod
                 changed.add(file)
         return changed
 
+    def wait_for_changes(self):
+        """Blocks until any watched file changes, then returns all that have"""
+        while True:
+            if not self.inotify:
+                time.sleep(ChangeWatcher.POLL_INTERVAL)
+                changed = self.find_changes()
+            else:
+                written = self.inotify.read()
+                # an editor's save can be several events, so gather up
+                # whatever's already queued behind the first
+                while True:
+                    more = self.inotify.read(timeout=0)
+                    if not more:
+                        break
+                    written |= more
+                # of those, only watched files whose times moved, so a save
+                # that's several writes only counts once
+                written = {os.path.normpath(f) for f in written}
+                changed = self.find_changes([f for f in self.src_files
+                    if os.path.normpath(f) in written])
+            if changed:
+                return changed
+
 class BuildTimer(object):
     def __init__(self, warn_time, err_time):
         self.warn_time = warn_time
@@ -240,12 +422,51 @@ class BuildTimer(object):
             color, elapsed, Color.DEFAULT,
         ))
 
+def publish(built: str, dest: str):
+    """Moves a finished file into place in one step. The kernel reloads when
+    `dest` changes, and only ever sees the old file or the whole new one"""
+    os.replace(built, dest)
+
 def link_game(build: BuildTree):
     flags = ' '.join([INCLUDE, LIB, FLAGS, LINK, DBG_FLAGS])
-    flags += ' -s -shared'
+    flags += ' -s -shared ' + GAME_LINK_FLAGS
     objfiles = ' '.join(cpp_to_obj(cpp) for cpp, _ in build.objs)
-    log(Color.INFO, 'linking game.dll...')
-    return run_cmd('g++ -o out/game.dll {0} {1}'.format(objfiles, flags))
+    game_lib = os.path.join('out', GAME_LIB)
+    # linked under another name, since the linker writes it a piece at a time
+    built = game_lib + '.tmp'
+    log(Color.INFO, 'linking {}...'.format(GAME_LIB))
+    if not run_cmd('g++ -o {0} {1} {2}'.format(built, objfiles, flags)):
+        return False
+    publish(built, game_lib)
+    return True
+
+def build_game(build: BuildTree, is_stale) -> bool:
+    """Builds each obj that `is_stale(cpp, deps)` or is missing, then relinks
+    the game if any were built. Returns False if anything failed to build"""
+    to_build = [(cpp, cpp_to_obj(cpp)) for cpp, deps in build.objs
+        if is_stale(cpp, deps) or not os.path.exists(cpp_to_obj(cpp))]
+    with BuildTimer(5, 30) as timer:
+        # use the timer's build flag to keep them in sync
+        timer.did_build = bool(to_build) \
+            or not os.path.exists(os.path.join('out', GAME_LIB))
+        # the link starts as soon as the last obj's done; unless any failed,
+        # since a half-updated game would only crash on reload
+        ok = build_objs(to_build)
+        if timer.did_build and ok:
+            ok = link_game(build)
+    return ok
+
+@Program('build')
+def build_once(*args):
+    """Brings the game up to date once, rebuilding whatever objs are older
+    than their sources; what `scythe --rebuild` runs in the background"""
+    ensure_outdir()
+    build = BuildTree('program')
+    def is_stale(cpp, deps):
+        obj = cpp_to_obj(cpp)
+        built = os.path.getmtime(obj) if os.path.exists(obj) else 0
+        return any(os.path.getmtime(f) > built for f in [cpp, *deps])
+    return 0 if build_game(build, is_stale) else 1
 
 @Program('watch')
 def watch_and_build(*args):
@@ -259,8 +480,6 @@ def watch_and_build(*args):
             assert False, "unknown argument: "+arg
     build = BuildTree('program')
     modified = {}
-    for file in build.files:
-        modified[file] = os.path.getmtime(file)
     for cpp, _ in build.objs:
         # initialize .cpp modified times to .o file times, in case we made changes
         # before starting the watch script
@@ -269,44 +488,27 @@ def watch_and_build(*args):
             modified[cpp] = os.path.getmtime(obj)
         else:
             modified[cpp] = 0
+    watcher = ChangeWatcher(build.files, modified)
+    if not watcher.inotify:
+        log(Color.WARN, 'no inotify; polling for changes instead')
 
+    # anything changed since the last build counts
+    changed = watcher.find_changes()
     while True:
-        # for all known files, rebuild only if stale
-        changed = set()
-        for file in build.files:
-            mod = os.path.getmtime(file)
-            if mod > modified[file]:
-                modified[file] = mod
-                changed.add(file)
-
         # if files changed, re-scan dependencies (which can find new files)
         if changed or force_build:
             print('')
             log(Color.INFO, 'files changed:', len(changed))
             build = BuildTree('program')
-            # needing to update modified times is kinda gross but aight
-            for f in build.files:
-                if f not in modified:
-                    modified[f] = os.path.getmtime(f)
+            watcher.watch(build.files)
 
             # build any changes
-            with BuildTimer(5, 30) as timer:
-                timer.did_build = False # use the timer's build flag to keep them in sync
-                for cpp, deps in build.objs:
-                    obj = cpp_to_obj(cpp)
-                    code_change = cpp in changed or any(dep in changed for dep in deps)
-                    obj_missing = not os.path.exists(obj)
-                    if force_build or code_change or obj_missing:
-                        if build_obj(cpp, obj):
-                            timer.did_build = True
-                force_build = False
-
-                # relink the .dll if any objs changed
-                if timer.did_build:
-                    link_game(build)
-    
+            build_game(build, lambda cpp, deps: force_build
+                or cpp in changed or any(dep in changed for dep in deps))
+            force_build = False
+
         sys.stdout.flush()
-        time.sleep(0.1)
+        changed = watcher.wait_for_changes()
 
 @Program('test')
 def run_tests():
@@ -318,22 +520,41 @@ def run_tests():
     watch = ChangeWatcher(src_files)
 
     first_run = True
+    changed = set()
     while True:
-        # for all known files, rebuild only if stale
-        changed = watch.find_changes()
+        print('')
+        if not first_run:
+            log(Color.INFO, 'files changed:', len(changed))
+        first_run = False
 
-        if changed or first_run:
-            print('')
-            if not first_run:
-                log(Color.INFO, 'files changed:', len(changed))
-            first_run = False
+        with BuildTimer(2.5, 10.0):
+            run_cmd('sh ./test.sh')
 
-            with BuildTimer(2.5, 10.0):
-                run_cmd('sh ./test.sh')
+        sys.stdout.flush()
+        changed = watch.wait_for_changes()
 
+@Program('bench')
+def run_benchmarks(*args):
+    """Builds the benchmark program with optimizations on, then runs it once.
+    Any args are passed along as filters on which benches to run"""
+    ensure_outdir()
+    # optimized objs live separately so they don't clobber the debug ones
+    outdir = os.path.join('out', 'bench')
+    os.makedirs(outdir, exist_ok=True)
+    build = BuildTree('benchRunner')
+    to_build = [(cpp, cpp_to_obj(cpp, outdir)) for cpp, _ in build.objs]
+    objs = [obj for _, obj in to_build]
+    with BuildTimer(5, 30):
+        if not build_objs(to_build, BENCH_FLAGS):
+            return 1
+        flags = ' '.join([INCLUDE, LIB, FLAGS, LINK, BENCH_FLAGS])
+        log(Color.INFO, 'linking benchRunner...')
+        if not run_cmd('g++ -o out/benchRunner {0} {1}'.format(' '.join(objs), flags)):
+            return 1
 
-        sys.stdout.flush()
-        time.sleep(0.1)
+    os.chdir('out')
+    sys.stdout.flush()
+    return os.system(' '.join([os.path.join('.', 'benchRunner')] + list(args)))
 
 @Program('walk')
 def walk_build_tree(root_name='program'):
@@ -351,8 +572,6 @@ def walk_build_tree(root_name='program'):
     print([cpp_to_obj(cpp) for cpp, _ in build.objs])
 
 def main(args: list[str]):
-    # clear lockfile, in case the builder crashes or w/e
-    release_lock()
     if len(args) < 1:
         print('usage: python build.py [command]')
         print('valid commands:')
@@ -0,0 +1,128 @@
+#include "atlas.h"
+
+AtlasPacker::AtlasPacker(Vec2i size) : _size(size) {
+    reset();
+}
+
+bool AtlasPacker::insert(Vec2i size, Vec2i* pos) {
+    if (size.x <= 0 || size.y <= 0 || size.x > _size.x || size.y > _size.y) {
+        return false;
+    }
+    if (!insertIntoHole(size, pos)) {
+        // lowest top edge wins, then leftmost
+        int best = -1, bestY = 0;
+        for (int i = 0; i < _skyline.size(); ++i) {
+            int y = fitAt(i, size);
+            if (y >= 0 && (best < 0 || y < bestY)) {
+                best = i;
+                bestY = y;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        *pos = {_skyline[best].x, bestY};
+
+        // raise the skyline under the new rect, trimming whatever it covers
+        Segment added { pos->x, bestY + size.y, size.x };
+        int right = added.x + added.w;
+        std::vector<Segment> skyline;
+        for (auto seg : _skyline) {
+            int segRight = seg.x + seg.w;
+            if (segRight <= added.x || seg.x >= right) {
+                skyline.push_back(seg);
+                continue;
+            }
+            if (seg.x < added.x) {
+                skyline.push_back({seg.x, seg.y, added.x - seg.x});
+            }
+            if (seg.x <= added.x) {
+                skyline.push_back(added);
+            }
+            if (segRight > right) {
+                skyline.push_back({right, seg.y, segRight - right});
+            }
+        }
+        // merge neighbors at the same height, so the list stays short
+        _skyline.clear();
+        for (auto seg : skyline) {
+            if (!_skyline.empty() && _skyline.back().y == seg.y) {
+                _skyline.back().w += seg.w;
+            } else {
+                _skyline.push_back(seg);
+            }
+        }
+    }
+    _count++;
+    _usedArea += size.x * size.y;
+    return true;
+}
+
+void AtlasPacker::remove(Vec2i pos, Vec2i size) {
+    check(_count > 0, "removing from an empty atlas page");
+    _count--;
+    _usedArea -= size.x * size.y;
+    if (_count == 0) {
+        reset();
+        return;
+    }
+    _holes.push_back({pos, size});
+}
+
+void AtlasPacker::reset() {
+    _skyline = { {0, 0, _size.x} };
+    _holes.clear();
+    _count = 0;
+    _usedArea = 0;
+}
+
+int AtlasPacker::count() const {
+    return _count;
+}
+float AtlasPacker::occupancy() const {
+    return float(_usedArea) / (_size.x * _size.y);
+}
+
+bool AtlasPacker::insertIntoHole(Vec2i size, Vec2i* pos) {
+    // the smallest hole it fits in, to keep big holes for big rects
+    int best = -1;
+    for (int i = 0; i < _holes.size(); ++i) {
+        Vec2i hole = _holes[i].size;
+        if (hole.x >= size.x && hole.y >= size.y && (best < 0
+                || hole.x*hole.y < _holes[best].size.x*_holes[best].size.y)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    Hole hole = _holes[best];
+    _holes.erase(_holes.begin() + best);
+    *pos = hole.pos;
+    // whatever's left over becomes two smaller holes: the strip to the right
+    // of the rect, and everything below it
+    Hole right { {hole.pos.x + size.x, hole.pos.y}, {hole.size.x - size.x, size.y} };
+    Hole below { {hole.pos.x, hole.pos.y + size.y}, {hole.size.x, hole.size.y - size.y} };
+    for (auto h : {right, below}) {
+        if (h.size.x > 0 && h.size.y > 0) {
+            _holes.push_back(h);
+        }
+    }
+    return true;
+}
+
+int AtlasPacker::fitAt(int i, Vec2i size) const {
+    int x = _skyline[i].x;
+    if (x + size.x > _size.x) {
+        return -1;
+    }
+    // sits on the highest segment it spans
+    int y = 0;
+    for (int j = i; j < _skyline.size() && _skyline[j].x < x + size.x; ++j) {
+        y = max(y, _skyline[j].y);
+    }
+    if (y + size.y > _size.y) {
+        return -1;
+    }
+    return y;
+}
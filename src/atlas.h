@@ -0,0 +1,78 @@
+// AtlasPacker - places rects on a fixed-size texture page
+
+#pragma once
+
+#include "common.h"
+#include "test.h"
+#include "vec.h"
+
+#include <vector>
+
+/// @brief Packs rects into a page, each one as low and as far left as it'll
+/// go, tracking the top edge of the used space as a skyline. Rects can be
+/// removed again without repacking anything: the hole they leave is reused
+/// by later inserts that fit in it, and the page starts over once it's empty
+class AtlasPacker {
+    Vec2i _size;
+
+    // a horizontal run of the skyline; everything below `y` is spoken for
+    struct Segment {
+        int x, y, w;
+    };
+    std::vector<Segment> _skyline; // left to right, covering the full width
+    struct Hole {
+        Vec2i pos, size;
+    };
+    std::vector<Hole> _holes;
+    int _count = 0;
+    int _usedArea = 0;
+
+public:
+    AtlasPacker(Vec2i size);
+
+    /// @brief Finds room for a rect
+    /// @param pos set to where the rect's upper-left corner goes
+    /// @return false if it doesn't fit anywhere
+    bool insert(Vec2i size, Vec2i* pos);
+    /// @brief Frees a rect previously returned by `insert`
+    void remove(Vec2i pos, Vec2i size);
+    void reset();
+
+    int count() const;
+    /// @brief Fraction of the page covered by rects currently in it
+    float occupancy() const;
+
+private:
+    bool insertIntoHole(Vec2i size, Vec2i* pos);
+    /// @return the y the rect would sit at if its left edge were on segment
+    /// `i`, or -1 if it'd stick out of the page
+    int fitAt(int i, Vec2i size) const;
+};
+
+TEST(atlasPacker, {
+    AtlasPacker packer({64, 64});
+    Vec2i pos[5];
+    for (int i = 0; i < 4; ++i) {
+        TEST_EQ_MSG(packer.insert({32, 32}, &pos[i]), true, "four quarters fit");
+    }
+    TEST_EQ_MSG(packer.insert({1, 1}, &pos[4]), false, "full page rejects");
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i+1; j < 4; ++j) {
+            TEST_EQ_MSG(pos[i] == pos[j], false, "no two rects overlap");
+        }
+    }
+    packer.remove(pos[2], {32, 32});
+    TEST_EQ(packer.count(), 3);
+    Vec2i reused;
+    TEST_EQ_MSG(packer.insert({16, 32}, &reused), true, "holes get reused");
+    TEST_EQ(reused == pos[2], true);
+    TEST_EQ_MSG(packer.insert({16, 16}, &reused), true, "leftovers get reused");
+    TEST_EQ(reused.x, pos[2].x + 16);
+    for (auto p : {pos[0], pos[1], pos[3]}) {
+        packer.remove(p, {32, 32});
+    }
+    packer.remove(pos[2], {16, 32});
+    packer.remove(reused, {16, 16});
+    TEST_EQ_MSG(packer.count(), 0, "empty pages start over");
+    TEST_EQ(packer.insert({64, 64}, &reused), true);
+})
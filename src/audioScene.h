@@ -4,7 +4,7 @@
 
 #include "color.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "scene.h"
 #include "ui.h"
 
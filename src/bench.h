@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef BENCHMARKING
+
+// nop bench definitions for non-bench mode
+#define BENCH(name, ...)
+
+#else // BENCHMARKING
+
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+struct BenchCase {
+    std::string name;
+    void (*benchFn)();
+};
+std::vector<BenchCase> gBenchCases;
+// this function gets called to give us static initializers
+int push_bench_case(BenchCase bc) {
+    gBenchCases.push_back(bc);
+    return gBenchCases.size();
+}
+
+/// @brief High-resolution scoped timer; prints the average time per iteration
+/// when it goes out of scope
+class BenchTimer {
+    const char* _label;
+    int _iters;
+    Uint64 _start;
+public:
+    BenchTimer(const char* label, int iters = 1)
+        : _label(label), _iters(iters), _start(SDL_GetPerformanceCounter()) {}
+    ~BenchTimer() {
+        double us = elapsedUs();
+        printf("  %-40s %12.3fus/iter (%d iters, %.2fms total)\n",
+            _label, us/_iters, _iters, us/1000.0);
+    }
+
+    double elapsedUs() const {
+        Uint64 ticks = SDL_GetPerformanceCounter() - _start;
+        return 1'000'000.0 * ticks / SDL_GetPerformanceFrequency();
+    }
+};
+
+/// @brief Keeps the optimizer from deleting work whose result we don't use
+template <typename T>
+void doNotOptimize(T const& val) {
+    asm volatile("" : : "g"(&val) : "memory");
+}
+
+#define BENCH(name, ...) \
+    void bench__##name() { \
+        __VA_ARGS__ \
+    } \
+    static int bench__##name##__id = push_bench_case(BenchCase {#name, bench__##name});
+
+/// @brief Runs the trailing block `iters` times, timing the whole loop
+#define BENCH_LOOP(label, iters, ...) { \
+        BenchTimer _bench_timer(label, iters); \
+        for (int _bench_i = 0; _bench_i < (iters); ++_bench_i) { \
+            __VA_ARGS__ \
+        } \
+    }
+
+#endif // BENCHMARKING
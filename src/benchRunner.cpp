@@ -0,0 +1,30 @@
+// bench.exe - Standalone benchmark runner
+
+// the bench app is always built with benchmarking enabled
+#define BENCHMARKING
+
+#include "input_sdl.h"
+#include "render_soft.h"
+#include "spatialHash.h"
+#include "texGen.h"
+#include "uiBench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char** argv) {
+    // any args are treated as filters; run benches whose name contains one
+    for (auto &bc : gBenchCases) {
+        bool selected = argc <= 1;
+        for (int i = 1; i < argc; ++i) {
+            selected |= strstr(bc.name.c_str(), argv[i]) != nullptr;
+        }
+        if (!selected) {
+            continue;
+        }
+        printf("bench %s\n", bc.name.c_str());
+        bc.benchFn();
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "buildProcess.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+BuildProcess::BuildProcess() {
+    _outputLock = SDL_CreateMutex();
+}
+
+BuildProcess::~BuildProcess() {
+    // can't stop the process, but can wait for it rather than leave it
+    // writing to a pipe nobody's reading
+    wait();
+    SDL_DestroyMutex(_outputLock);
+}
+
+bool BuildProcess::start(const std::string &cmd) {
+    if (_running) {
+        return false;
+    }
+    wait();
+    _cmd = "(" + cmd + ") 2>&1";
+    _running = true;
+    _finished = false;
+    _timer = Timer();
+    _thread = SDL_CreateThread(runThread, "build", this);
+    if (!check(_thread, "couldn't start build thread: %s", SDL_GetError())) {
+        _running = false;
+        return false;
+    }
+    return true;
+}
+
+bool BuildProcess::running() const {
+    return _running;
+}
+
+void BuildProcess::takeOutput(std::vector<std::string> &lines) {
+    SDL_LockMutex(_outputLock);
+    for (auto &line : _output) {
+        lines.push_back(std::move(line));
+    }
+    _output.clear();
+    SDL_UnlockMutex(_outputLock);
+}
+
+bool BuildProcess::takeFinished(int* status, float* seconds) {
+    if (!_finished) {
+        return false;
+    }
+    _finished = false;
+    *status = _status;
+    *seconds = _seconds;
+    return true;
+}
+
+int BuildProcess::runThread(void* data) {
+    ((BuildProcess*)data)->run();
+    return 0;
+}
+
+void BuildProcess::run() {
+#ifdef _WIN32
+    FILE* pipe = _popen(_cmd.c_str(), "r");
+#else
+    FILE* pipe = popen(_cmd.c_str(), "r");
+#endif
+    if (!pipe) {
+        SDL_LockMutex(_outputLock);
+        _output.push_back("couldn't run: " + _cmd);
+        SDL_UnlockMutex(_outputLock);
+        _status = -1;
+    } else {
+        char buffer[1024];
+        while (fgets(buffer, sizeof(buffer), pipe)) {
+            size_t len = strlen(buffer);
+            if (len > 0 && buffer[len-1] == '\n') {
+                buffer[len-1] = '\0';
+            }
+            SDL_LockMutex(_outputLock);
+            _output.push_back(buffer);
+            SDL_UnlockMutex(_outputLock);
+        }
+#ifdef _WIN32
+        _status = _pclose(pipe);
+#else
+        int status = pclose(pipe);
+        _status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+    }
+    // when it exited, not whenever someone gets around to asking
+    _seconds = _timer.elapsed();
+    // after _status and _seconds, so whoever sees _finished sees them too
+    _finished = true;
+    _running = false;
+}
+
+void BuildProcess::wait() {
+    if (_thread) {
+        SDL_WaitThread(_thread, nullptr);
+        _thread = nullptr;
+    }
+}
@@ -0,0 +1,51 @@
+// buildProcess.h - runs a build in the background, streaming its output
+
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+/// @brief Runs a shell command as its own process, waited on from a thread
+/// of its own, so whoever started it carries on while it runs. Output comes
+/// back a line at a time, for the caller to log whenever it's ready to.
+/// One command at a time
+class BuildProcess {
+    SDL_Thread* _thread = nullptr;
+    SDL_mutex* _outputLock;
+    // lines not taken yet; guarded by _outputLock
+    std::vector<std::string> _output;
+    std::string _cmd;
+    std::atomic<bool> _running {false};
+    std::atomic<bool> _finished {false};
+    int _status = 0; // written before _finished is set
+    float _seconds = 0; // likewise
+    Timer _timer;
+
+public:
+    BuildProcess();
+    ~BuildProcess();
+
+    /// @brief Starts running `cmd`, with stderr merged into stdout
+    /// @return false if something's already running
+    bool start(const std::string &cmd);
+
+    bool running() const;
+
+    /// @brief Moves any output since the last call onto the end of `lines`
+    void takeOutput(std::vector<std::string> &lines);
+
+    /// @brief Whether the command finished since the last call
+    /// @param status set to its exit status, 0 for success
+    /// @param seconds set to how long it ran
+    bool takeFinished(int* status, float* seconds);
+
+private:
+    static int runThread(void* data);
+    void run();
+    void wait();
+};
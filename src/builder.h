@@ -1,90 +1,54 @@
 #pragma once
 
+#include "buildProcess.h"
 #include "common.h"
+#include "fileWatcher.h"
 
-#include <map>
 #include <set>
 #include <stdio.h>
+#include <string>
+#include <sys/stat.h>
 #include <vector>
-#include <windows.h>
 
 // we want to track every source file and any transitive dependencies
 // so create a graph by scanning files for #includes
 
 class Builder {
-    // List of filenames to watch for changes to rebuild game.dll
-    // TODO: should probably this to the file watching API before this list gets
-    // too big, at 8 files watched I can already see 0.5% additional CPU usage :(
-    // updating this is starting to get obnoxious... prolly worth at least scanning
-    // for .h files or smth istg
-    std::vector<const char*> filesToScan {
-        "../src/color.h",
-        "../src/common.h",
-        "../src/common.cpp",
-        "../src/input_sdl.h",
-        "../src/render_sdl.h",
-        "../src/scene.h",
-        "../src/serialize.h",
-        "../src/texGen.h",
-        "../src/ui.h",
-        "../src/vec.h",
-
-        "../src/eyeGenScene.h",
-        "../src/eyeGenScene.cpp",
-        "../src/gameScene.h",
-        // "../src/particleScene.h", // built with build.py
-        "../src/rpgScene.h",
-        "../src/texGenScene.h",
-
-        "../src/program.cpp",
+    // any source changing starts a build, which works out what it affects
+    std::vector<const char*> sourcePatterns {
+        "../src/*.cpp",
+        "../src/*.h",
     };
-    // The last time each file was modified
-    std::map<const char*, FILETIME> lastModifiedTimes;
-    const char* gameDll = "game.dll";
-    const char* lockfile = "game.dll.lock";
-    bool _needsReload = false;
+    // changes come from the kernel's watcher, which it polls each frame
+    FileWatcher* _watcher;
+    std::vector<int> _sourceIds;
+    int _dllId;
+    const char* gameDll;
+
+    BuildProcess _build;
+    bool _rebuildQueued = false;
+    // build.py knows the dependency graph, and publishes the library by
+    // renaming it into place; -u so its output isn't held back in a buffer
+#ifdef _WIN32
+    const char* buildCommand = "cd .. && python -u build.py build";
+#else
+    const char* buildCommand = "cd .. && python3 -u build.py build";
+#endif
 
 public:
-    Builder() {
-        // initialize last modified times for each file we care about
-        for (auto filename : filesToScan) {
-            lastModifiedTimes[filename] = getFileModifiedTime(filename);
+    /// @param gameLib the library to build, and reload when it changes
+    Builder(FileWatcher* watcher, const char* gameLib) :
+            _watcher(watcher), gameDll(gameLib) {
+        for (auto pattern : sourcePatterns) {
+            _sourceIds.push_back(_watcher->watch(pattern));
         }
-        lastModifiedTimes[gameDll] = getFileModifiedTime(gameDll);
+        _dllId = _watcher->watch(gameDll);
     }
 
 private:
-    /// @brief Get the time that a file was last modified
-    FILETIME getFileModifiedTime(const char* filename) {
-        FILETIME modified;
-        HANDLE file = CreateFile(filename, 0, 0, nullptr,
-            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-        assert(file != INVALID_HANDLE_VALUE, "failed to load file %s", filename);
-        assert(GetFileTime(file, nullptr, nullptr, &modified),
-            "couldn't get file time for %s", filename);
-        CloseHandle(file);
-        return modified;
-    }
-
     bool fileExists(const char* filename) {
-        HANDLE file = CreateFile(filename, 0, 0, nullptr,
-            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-        bool ret = file != INVALID_HANDLE_VALUE;
-        CloseHandle(file);
-        return ret;
-    }
-
-    // caution, stateful
-    // we're deprecating this so who cares
-    bool checkFileChange(const char* filename) {
-        FILETIME last = lastModifiedTimes[filename];
-        FILETIME modified = getFileModifiedTime(filename);
-        if (modified.dwLowDateTime != last.dwLowDateTime ||
-                modified.dwHighDateTime != last.dwHighDateTime) {
-            lastModifiedTimes[filename] = modified;
-            return true;
-        }
-        return false;
+        struct stat info;
+        return stat(filename, &info) == 0;
     }
 
 public:
@@ -92,90 +56,49 @@ public:
     /// @return true if any source files have changed
     bool shouldRebuild() {
         bool changed = false;
-        for (auto filename : filesToScan) {
-            changed |= checkFileChange(filename);
+        for (auto id : _sourceIds) {
+            changed |= _watcher->takeChange(id);
         }
         return changed;
     }
 
+    /// @brief Whether a new build of the dll has been published. Builds are
+    /// linked under another name and renamed into place, so once the dll
+    /// changes, all of it's there; no lockfile needed
     bool shouldReload() {
         // the dll may not exist if the build fails in the linking phase
-        if (!fileExists(gameDll)) {
-            // early-return cause checkFileChange will assert
-            return false;
-        }
-        // we store the need to reload as a member var because we want to
-        // be able to have the file change and defer reloading it until we're
-        // sure it's finished building
-        if (checkFileChange(gameDll)) {
-            _needsReload = true;
-        }
-        bool ret = _needsReload;
-        // if the lockfile exists, we may be in the process of writing the dll
-        if (fileExists(lockfile)) {
-            ret = false;
-        }
-        // only actually unset the flag when this returns true
-        if (ret) {
-            _needsReload = false;
-        }
-        return ret;
+        return _watcher->takeChange(_dllId) && fileExists(gameDll);
     }
 
-    /// @brief rebuilds the game if possible
-    /// @return true if we rebuilt successfully
-    bool tryRebuild() {
-        // check program.cpp for changes
+    /// @brief Rebuilds the game in the background whenever its sources
+    /// change, and logs the build's output as it comes. Call once a frame;
+    /// it never waits on the build. Whatever the build publishes gets picked
+    /// up by `shouldReload`, so the old code keeps running until then
+    void update() {
         if (shouldRebuild()) {
-            log("rebuilding game.dll...");
-            return check(buildGame(), "failed to build dll, continuing with old code");
+            _rebuildQueued = true;
         }
-        // no build means nothing to do downstream either
-        return false;
-    }
 
-    /// @brief Builds the game.dll from source
-    /// @return true iff the build succeeded
-    bool buildGame() {
-        Timer buildTime;
-
-        std::string flags = " -s -shared -lmingw32 -lSDL2 -lSDL2_image"
-            " -fdiagnostics-color=always -g";
-        std::vector<std::string> objs {
-            "common",
-            "eyeGenScene",
-            // we omit it from files to scan, but we do need to make sure it's built
-            "particleScene",
-            "program",
-        };
-
-        // build
-        for (auto obj : objs) {
-            std::string cmd = "g++ -c -o "+obj+".o ../src/"+obj+".cpp" + flags;
-            Timer time;
-            log("building obj %s: %s", obj.c_str(), cmd.c_str());
-            // nonzero status means something failed
-            fflush(stdout);
-            auto success = system(cmd.c_str()) == 0;
-            log("  build time: %fs", time.elapsed());
-            if (!success) {
-                return false;
+        std::vector<std::string> output;
+        _build.takeOutput(output);
+        for (auto &line : output) {
+            log("  | %s", line.c_str());
+        }
+        int status;
+        float seconds;
+        if (_build.takeFinished(&status, &seconds)) {
+            if (check(status == 0,
+                    "failed to build %s, continuing with old code", gameDll)) {
+                log("built %s in %.2fs", gameDll, seconds);
             }
         }
 
-        // link
-        std::string cmd = "g++ -o game.dll";
-        for (auto obj : objs) {
-            cmd += " "+obj+".o";
+        // changes made mid-build get a build of their own once it's done
+        if (_rebuildQueued && !_build.running()) {
+            _rebuildQueued = false;
+            log("rebuilding %s in the background...", gameDll);
+            _build.start(buildCommand);
         }
-        cmd += flags;
-        Timer linkTime;
-        log("linking game.dll: %s", cmd.c_str());
-        fflush(stdout);
-        bool success = system(cmd.c_str()) == 0;
-        log("  link time: %fs", linkTime.elapsed());
-        log("Total build time: %fs", buildTime.elapsed());
-        return success;
     }
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "serialize.h"
 
 #include <math.h>
 #include <fstream>
@@ -72,3 +73,27 @@ struct Gradient {
 
 std::ostream& operator<<(std::ostream &stream, Gradient const& gradient);
 std::istream& operator>>(std::istream &stream, Gradient &gradient);
+
+template <>
+struct SerialFields<Color> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("r", &Color::r),
+        serialField("g", &Color::g),
+        serialField("b", &Color::b),
+        serialField("a", &Color::a));
+};
+template <>
+struct SerialFields<GradientStep> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("color", &GradientStep::color),
+        serialField("pos", &GradientStep::pos));
+};
+// binary files store the steps as an array, which can be used in place
+template <>
+struct SerialFields<Gradient> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("steps", &Gradient::steps));
+};
@@ -7,6 +7,12 @@
 
 #include <SDL2/SDL.h>
 
+#ifndef _WIN32
+// game.dll's exports are written the Windows way; these mean the same for gcc
+#define __declspec(x) __attribute__((visibility("default")))
+#define __cdecl
+#endif
+
 static const float PI = 3.1415926535;
 static const float TAU = 2*PI;
 
@@ -0,0 +1,84 @@
+#include "damage.h"
+
+DamageList::DamageList(int maxRects) : _maxRects(maxRects) {
+}
+
+void DamageList::clear() {
+    _rects.clear();
+}
+
+void DamageList::add(Rect rect) {
+    if (rect.size.x <= 0 || rect.size.y <= 0) {
+        return;
+    }
+    // absorb everything the new rect touches; the union can grow to touch
+    // rects we already passed, so start over after each merge
+    for (int i = 0; i < _rects.size();) {
+        if (touches(_rects[i], rect)) {
+            rect = unite(rect, _rects[i]);
+            _rects[i] = _rects.back();
+            _rects.pop_back();
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+    _rects.push_back(rect);
+
+    if (_rects.size() > _maxRects) {
+        // merge whichever pair adds the least area that didn't need redrawing
+        int bestA = 0, bestB = 1;
+        float bestWaste = INFINITY;
+        for (int a = 0; a < _rects.size(); ++a) {
+            for (int b = a+1; b < _rects.size(); ++b) {
+                Rect u = unite(_rects[a], _rects[b]);
+                float waste = u.size.x*u.size.y
+                    - _rects[a].size.x*_rects[a].size.y
+                    - _rects[b].size.x*_rects[b].size.y;
+                if (waste < bestWaste) {
+                    bestWaste = waste;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        Rect merged = unite(_rects[bestA], _rects[bestB]);
+        // bestB > bestA, so removing it first leaves bestA's index valid
+        _rects.erase(_rects.begin() + bestB);
+        _rects.erase(_rects.begin() + bestA);
+        add(merged);
+    }
+}
+
+bool DamageList::empty() const {
+    return _rects.empty();
+}
+
+const std::vector<Rect>& DamageList::rects() const {
+    return _rects;
+}
+
+float DamageList::area() const {
+    float total = 0;
+    for (auto &r : _rects) {
+        total += r.size.x * r.size.y;
+    }
+    return total;
+}
+
+bool touches(Rect a, Rect b) {
+    return a.pos.x <= b.pos.x + b.size.x && b.pos.x <= a.pos.x + a.size.x
+        && a.pos.y <= b.pos.y + b.size.y && b.pos.y <= a.pos.y + a.size.y;
+}
+
+Rect unite(Rect a, Rect b) {
+    Vec2 lo = min(a.pos, b.pos);
+    Vec2 hi = max(a.pos + a.size, b.pos + b.size);
+    return {lo, hi - lo};
+}
+
+Rect intersect(Rect a, Rect b) {
+    Vec2 lo = max(a.pos, b.pos);
+    Vec2 hi = min(a.pos + a.size, b.pos + b.size);
+    return {lo, max(hi - lo, Vec2{0})};
+}
@@ -0,0 +1,52 @@
+// DamageList - screen regions that need redrawing this frame
+
+#pragma once
+
+#include "common.h"
+#include "test.h"
+#include "vec.h"
+
+#include <vector>
+
+/// @brief A small set of rects covering everything that changed. Overlapping
+/// or touching rects get merged as they're added, and past `maxRects` the two
+/// that waste the least area when combined are merged, so redrawing stays a
+/// handful of passes no matter how scattered the damage is
+class DamageList {
+    std::vector<Rect> _rects;
+    int _maxRects;
+
+public:
+    DamageList(int maxRects = 16);
+
+    void clear();
+    /// @brief Marks `rect` as needing a redraw; empty rects are ignored
+    void add(Rect rect);
+
+    bool empty() const;
+    const std::vector<Rect>& rects() const;
+    /// @brief Total area covered; rects never overlap, so this is exact
+    float area() const;
+};
+
+/// @brief Whether two rects overlap or share an edge
+bool touches(Rect a, Rect b);
+/// @brief Smallest rect containing both
+Rect unite(Rect a, Rect b);
+/// @brief The overlapping part of two rects; zero size if they don't
+Rect intersect(Rect a, Rect b);
+
+TEST(damageListMerge, {
+    DamageList damage(2);
+    damage.add({{0, 0}, {10, 10}});
+    damage.add({{5, 5}, {10, 10}});
+    TEST_EQ_MSG(damage.rects().size(), 1, "overlapping rects merge");
+    TEST_EQ(damage.area(), 15*15);
+    damage.add({{100, 0}, {10, 10}});
+    damage.add({{15, 0}, {5, 5}});
+    TEST_EQ_MSG(damage.rects().size(), 2, "touching rects merge");
+    damage.add({{0, 100}, {10, 10}});
+    TEST_EQ_MSG(damage.rects().size(), 2, "never more than maxRects");
+    damage.add({{0, 0}, {0, 10}});
+    TEST_EQ_MSG(damage.rects().size(), 2, "empty rects are ignored");
+})
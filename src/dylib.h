@@ -6,17 +6,32 @@
 
 #include <SDL2/SDL.h>
 
+#include <string>
+
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #endif
 
+class FileWatcher;
+class InputLog;
+class ReloadState;
+class Renderer;
+
 struct GameDylib {
 private:
     void* _gameLib;
     const char* _filename;
+    // identifies the build that's loaded: its inode, where there are inodes
+    Uint64 _version = 0;
+    double _builtAt = 0; // see builtAt
 
 public:
-    typedef void* (__cdecl *newGame_t)(Allocator*);
+    typedef void* (__cdecl *newGame_t)(Allocator*, Renderer*, InputLog*,
+        ReloadState*, FileWatcher*);
     newGame_t newGame;
     typedef void (__cdecl *freeGame_t)(void*, Allocator*);
     freeGame_t freeGame;
@@ -26,9 +41,11 @@ public:
     onLoad_t onLoad;
     typedef bool (__cdecl *shouldQuit_t)(void*);
     shouldQuit_t shouldQuit;
+    typedef void (__cdecl *startFrame_t)(void*);
+    startFrame_t startFrame;
     typedef int (__cdecl *update_t)(void*, float);
     update_t update;
-    typedef const void (__cdecl *renderScene_t)(void*);
+    typedef const void (__cdecl *renderScene_t)(void*, float);
     renderScene_t renderScene;
 
     GameDylib(const char* filename) : _filename(filename) {
@@ -44,27 +61,100 @@ public:
         load();
     }
 
+    /// @brief Whether the file on disk is a different build than the one
+    /// loaded. Builds are published by renaming them into place, so a new
+    /// one is always a new file
+    bool changedOnDisk() const;
+
+    /// @brief When the loaded build was written, i.e. when its link
+    /// finished, in seconds on the same clock as `wallClock`
+    double builtAt() const {
+        return _builtAt;
+    }
+
+    /// @brief Seconds since the epoch; unlike SDL's timers, comparable with
+    /// file times, e.g. to measure from `builtAt`
+    static double wallClock();
+
 private:
     void load();
     void unload();
 };
 
+/// @brief When a file was last written, in seconds since the epoch
+/// @param version set to something that identifies the file, where possible
+/// @return 0 if it doesn't exist
+static double fileModifiedTime(const char* filename, Uint64* version) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &data)) {
+        return 0;
+    }
+    // FILETIMEs count 100ns ticks from 1601
+    Uint64 ticks = (Uint64(data.ftLastWriteTime.dwHighDateTime) << 32)
+        | data.ftLastWriteTime.dwLowDateTime;
+    *version = ticks;
+    return ticks / 1e7 - 11644473600.0;
+#else
+    struct stat info;
+    if (stat(filename, &info) != 0) {
+        return 0;
+    }
+    *version = info.st_ino;
+    return info.st_mtim.tv_sec + info.st_mtim.tv_nsec / 1e9;
+#endif
+}
+
+double GameDylib::wallClock() {
+#ifdef _WIN32
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    Uint64 ticks = (Uint64(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    return ticks / 1e7 - 11644473600.0;
+#else
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+bool GameDylib::changedOnDisk() const {
+    Uint64 version = 0;
+    fileModifiedTime(_filename, &version);
+    return version != 0 && version != _version;
+}
+
 void GameDylib::load() {
     Tracer trace("GameDylib::load");
+    _builtAt = fileModifiedTime(_filename, &_version);
 #ifdef _WIN32
     // first we make a copy, so that we can overwrite the original without
     // windows yelling at us
-    static const char* copyDllName = "_copy_game.dll";
-    if (!CopyFile(_filename, copyDllName, /*failIfExists*/ false)) {
+    std::string loadName = "_copy_game.dll";
+    if (!CopyFile(_filename, loadName.c_str(), /*failIfExists*/ false)) {
         printf("!!couldn't copy %s\n", _filename);
         printf("  Fatal Error: %d\n", GetLastError());
         exit(1);
     }
+#else
+    // dlopen hands back whatever it already has open under the same name,
+    // and the old build can outlive dlclose (e.g. if it has any
+    // STB_GNU_UNIQUE symbols), so each build loads under a name of its own,
+    // after its inode. It's a hard link, so there's nothing to copy, and
+    // it's removed once loaded; the mapping keeps the file alive
+    std::string loadName = "./_" + std::string(_filename) + "."
+        + std::to_string(_version);
+    unlink(loadName.c_str());
+    assert(link(_filename, loadName.c_str()) == 0,
+        "couldn't link %s to %s", _filename, loadName.c_str());
 #endif
 
-    _gameLib = SDL_LoadObject(copyDllName);
+    _gameLib = SDL_LoadObject(loadName.c_str());
+#ifndef _WIN32
+    unlink(loadName.c_str());
+#endif
     trace("_gameLib addr=%x", _gameLib);
-    assert(_gameLib, "_gameLib failed to load");
+    assert(_gameLib, "_gameLib failed to load: %s", SDL_GetError());
 
     newGame = (newGame_t)SDL_LoadFunction(_gameLib, "newGame");
     trace("newGame addr=%x", newGame);
@@ -86,6 +176,10 @@ void GameDylib::load() {
     trace("shouldQuit addr=%x", shouldQuit);
     assert(shouldQuit, "shouldQuit didn't load");
 
+    startFrame = (startFrame_t)SDL_LoadFunction(_gameLib, "startFrame");
+    trace("startFrame addr=%x", startFrame);
+    assert(startFrame, "startFrame didn't load");
+
     update = (update_t)SDL_LoadFunction(_gameLib, "update");
     trace("update addr=%x", update);
     assert(update, "update didn't load");
@@ -2,7 +2,8 @@
 
 #include "common.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "pixelWriter.h"
+#include "render.h"
 #include "scene.h"
 #include "serialize.h"
 #include "ui.h"
@@ -12,24 +13,18 @@
 #include <SDL2/SDL.h>
 #include <math.h>
 
-SDL_Texture* EyeGenScene::EyeParams::generateTexture(Renderer* renderer) const {
+TextureHandle EyeGenScene::EyeParams::generateTexture(Renderer* renderer) const {
     int texSize = 256;
-    const int bpp = 32;
-    auto surface = SDL_CreateRGBSurface(
-        0, texSize, texSize, bpp,
-        // RGBA bitmasks; A mask is special
-        0xff, 0xff << 8, 0xff << 16, 0);
+    auto surface = renderer->createSurface(texSize, texSize);
+    PixelWriter pixels(surface, true);
     Vec2 ba = cornerB - cornerA;
     Vec2 right = ba.normalized();
     // {-y, x} is 90deg counterclockwise from {x, y}
     Vec2 up = Vec2{-right.y, right.x};
     for (int x = 0; x < texSize; ++x) {
         for (int y = 0; y < texSize; ++y) {
-            Color *pixel = (Color*)((Uint8*)surface->pixels
-                + y*surface->pitch
-                + x*surface->format->BytesPerPixel);
             Vec2 pos = Vec2 {float(x), float(y)} / texSize;
-            *pixel = Color::black;
+            Color pixel = Color::black;
 
             Vec2 pa = pos-cornerA;
             Vec2 uv {
@@ -42,17 +37,18 @@ SDL_Texture* EyeGenScene::EyeParams::generateTexture(Renderer* renderer) const {
                 float top = curveTop*uv.x*(uv.x - 1);
                 float bot = curveBot*uv.x*(1 - uv.x);
                 if (uv.y > top && uv.y < bot) {
-                    *pixel = Color::white;
+                    pixel = Color::white;
                     float r = (pos - pupil).len();
                     if (r < (pupilSize/2)) {
-                        *pixel = r/(pupilSize/2) < (1-iris)
+                        pixel = r/(pupilSize/2) < (1-iris)
                             ? Color::black : color;
                     }
                 }
             }
+            pixels.set(x, y, pixel);
         }
     }
-    auto tex = SDL_CreateTextureFromSurface(renderer->sdl(), surface);
+    auto tex = renderer->textures().create(surface, "eyegen");
     SDL_FreeSurface(surface);
     return tex;
 }
@@ -74,7 +70,9 @@ void EyeGenScene::onLoad() {
 
 void EyeGenScene::onUnload() {
     _ui.unload();
-    SDL_DestroyTexture(tex);
+    if (tex) {
+        _texRenderer->textures().release(tex);
+    }
 }
 
 void EyeGenScene::update(float dt) {
@@ -105,11 +103,11 @@ void EyeGenScene::update(float dt) {
     auto mouse = _input->getMousePos();
     auto pos = (mouse - previewPos)/previewSize;
     if (in_rect(pos, {0, 0}, {1, 1})) {
-        if (_input->isHeld("click")) {
+        if (_input->isHeld("click"_action)) {
             _shouldGenerate = true;
             _params.pupil = pos;
         }
-        if (_input->isHeld("rclick")) {
+        if (_input->isHeld("rclick"_action)) {
             _shouldGenerate = true;
             _params.cornerB = pos;
         }
@@ -130,7 +128,8 @@ void EyeGenScene::render(Renderer *renderer) {
 
 void EyeGenScene::generateTexture(Renderer* renderer) {
     if (tex) {
-        SDL_DestroyTexture(tex);
+        _texRenderer->textures().release(tex);
     }
     tex = _params.generateTexture(renderer);
+    _texRenderer = renderer;
 }
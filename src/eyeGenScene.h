@@ -4,7 +4,7 @@
 
 #include "color.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "scene.h"
 #include "serialize.h"
 #include "ui.h"
@@ -16,7 +16,8 @@ class EyeGenScene : public Scene {
     UI _ui;
     Input* _input;
 
-    SDL_Texture *tex = nullptr;
+    TextureHandle tex;
+    Renderer *_texRenderer = nullptr; // what created `tex`, to release it with
 
     Color bgColor {0x60, 0x1f, 0x80};
     Vec2 previewPos {800, 50};
@@ -30,7 +31,7 @@ class EyeGenScene : public Scene {
         float pupilSize, iris;
         Color color;
 
-        SDL_Texture* generateTexture(Renderer* renderer) const;
+        TextureHandle generateTexture(Renderer* renderer) const;
     } _params;
 
 public:
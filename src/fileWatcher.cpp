@@ -0,0 +1,194 @@
+#include "fileWatcher.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static bool isPattern(const std::string &name) {
+    return !name.empty() && name[0] == '*';
+}
+
+#ifdef _WIN32
+/// @return the file's last write time, or 0 if it doesn't exist. For a
+/// pattern, the sum over every file it matches, so adding or removing one
+/// counts as a change too
+static Uint64 modifiedTime(const std::string &path) {
+    auto fileTime = [](FILETIME time) {
+        return (Uint64(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    size_t slash = path.find_last_of("/\\");
+    if (isPattern(path.substr(slash == std::string::npos ? 0 : slash+1))) {
+        WIN32_FIND_DATAA found;
+        HANDLE find = FindFirstFileA(path.c_str(), &found);
+        if (find == INVALID_HANDLE_VALUE) {
+            return 0;
+        }
+        Uint64 sum = 0;
+        do {
+            sum += fileTime(found.ftLastWriteTime);
+        } while (FindNextFileA(find, &found));
+        FindClose(find);
+        return sum;
+    }
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    // unlike CreateFile, this doesn't leave a handle to close
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        return 0;
+    }
+    return fileTime(data.ftLastWriteTime);
+}
+#else
+// anything that can leave a file with new contents
+static const Uint32 watchMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+/// @brief Whether a file named `name` is one `pattern` watches
+static bool matches(const std::string &pattern, const char* name) {
+    if (!isPattern(pattern)) {
+        return pattern == name;
+    }
+    size_t len = strlen(name);
+    size_t suffix = pattern.size() - 1;
+    return len >= suffix
+        && memcmp(name + len - suffix, pattern.data() + 1, suffix) == 0;
+}
+#endif
+
+FileWatcher::FileWatcher() {
+#ifndef _WIN32
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    check(_fd >= 0, "inotify_init1 failed (errno=%d)", errno);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef _WIN32
+    for (auto &dir : _dirs) {
+        FindCloseChangeNotification((HANDLE)dir.handle);
+    }
+#else
+    if (_fd >= 0) {
+        // takes all its watches with it
+        close(_fd);
+    }
+#endif
+}
+
+int FileWatcher::watch(const char* filename) {
+    for (int i = 0; i < _files.size(); ++i) {
+        if (_files[i].path == filename) {
+            return i;
+        }
+    }
+    File file;
+    file.path = filename;
+    size_t slash = file.path.find_last_of("/\\");
+    std::string dir = slash == std::string::npos
+        ? "." : file.path.substr(0, slash);
+    file.name = slash == std::string::npos
+        ? file.path : file.path.substr(slash+1);
+    file.dir = watchDir(dir);
+    if (file.dir < 0) {
+        return -1;
+    }
+#ifdef _WIN32
+    file.modified = modifiedTime(file.path);
+#endif
+    _files.push_back(file);
+    return _files.size()-1;
+}
+
+int FileWatcher::watchDir(const std::string &path) {
+    for (int i = 0; i < _dirs.size(); ++i) {
+        if (_dirs[i].path == path) {
+            return i;
+        }
+    }
+#ifdef _WIN32
+    HANDLE handle = FindFirstChangeNotificationA(path.c_str(), false,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (!check(handle != INVALID_HANDLE_VALUE,
+            "couldn't watch %s (error=%d)", path.c_str(), GetLastError())) {
+        return -1;
+    }
+    _dirs.push_back({path, (intptr_t)handle});
+#else
+    int wd = _fd < 0 ? -1 : inotify_add_watch(_fd, path.c_str(), watchMask);
+    if (!check(wd >= 0, "couldn't watch %s (errno=%d)", path.c_str(), errno)) {
+        return -1;
+    }
+    _dirs.push_back({path, wd});
+#endif
+    return _dirs.size()-1;
+}
+
+void FileWatcher::poll() {
+#ifdef _WIN32
+    for (int i = 0; i < _dirs.size(); ++i) {
+        HANDLE handle = (HANDLE)_dirs[i].handle;
+        if (WaitForSingleObject(handle, 0) != WAIT_OBJECT_0) {
+            continue;
+        }
+        // all we know is something in the dir changed, so see what
+        for (auto &file : _files) {
+            if (file.dir != i) {
+                continue;
+            }
+            Uint64 modified = modifiedTime(file.path);
+            if (modified != file.modified) {
+                file.modified = modified;
+                file.changed = true;
+            }
+        }
+        FindNextChangeNotification(handle);
+    }
+#else
+    if (_fd < 0) {
+        return;
+    }
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t size = read(_fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            // EAGAIN, i.e. nothing more to read
+            break;
+        }
+        for (char* ptr = buffer; ptr < buffer + size; ) {
+            auto event = (const inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // events were dropped, so anything might have changed
+                for (auto &file : _files) {
+                    file.changed = true;
+                }
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+            for (auto &file : _files) {
+                if (_dirs[file.dir].handle == event->wd
+                        && matches(file.name, event->name)) {
+                    file.changed = true;
+                }
+            }
+        }
+    }
+#endif
+}
+
+bool FileWatcher::takeChange(int id) {
+    if (id < 0 || id >= _files.size()) {
+        return false;
+    }
+    bool changed = _files[id].changed;
+    _files[id].changed = false;
+    return changed;
+}
@@ -0,0 +1,64 @@
+// fileWatcher.h - finds out when files change, without polling each of them
+
+#pragma once
+
+#include "common.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// @brief Watches files for changes through the OS, rather than checking
+/// their modification times: inotify on Linux, change notifications on
+/// Windows. Both watch whole directories, so editors that save by renaming
+/// a new file over the old one still count.
+///
+/// `poll` collects whatever's happened since it last ran, and costs a single
+/// syscall when nothing has. Changes are coalesced per file, however many
+/// writes there were, until someone `takeChange`s them.
+///
+/// Owned by the kernel, which polls it once a frame, and handed to game.dll
+/// so assets can reload when they change on disk. Nothing virtual, so it
+/// survives reloads
+class FileWatcher {
+    struct Dir {
+        std::string path;
+        // inotify watch descriptor, or Windows change notification HANDLE
+        intptr_t handle;
+    };
+    struct File {
+        std::string path; // as passed to `watch`
+        std::string name; // within its directory; may start with a *
+        int dir;
+        bool changed = false;
+        // on Windows, to tell which file in a dir it was; for a pattern, the
+        // sum over every file it matches
+        Uint64 modified = 0;
+    };
+    std::vector<Dir> _dirs;
+    std::vector<File> _files;
+    int _fd = -1; // inotify instance
+
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    /// @brief Starts watching a file, which doesn't have to exist yet.
+    /// Watching the same path again gives the same id; a change is only
+    /// taken once, so each file should have one reader. A name starting
+    /// with * watches every file in the directory ending in the rest of it,
+    /// e.g. "src/*.cpp", including ones created later
+    /// @return an id to `takeChange` with, or -1 if its directory can't be
+    /// watched
+    int watch(const char* filename);
+
+    /// @brief Collects any changes since the last call
+    void poll();
+
+    /// @return whether the file changed since the last time this was called
+    /// for it, as of the last `poll`
+    bool takeChange(int id);
+
+private:
+    int watchDir(const std::string &path);
+};
@@ -0,0 +1,66 @@
+#include "format.h"
+
+#include <math.h>
+
+/// @brief Writes the digits of `num` to the end of the range ending at `end`,
+/// at least `minDigits` of them
+/// @return where the digits start
+static char* writeDigits(char* end, Uint64 num, int minDigits = 1) {
+    char* c = end;
+    while (num > 0 || minDigits > 0) {
+        *--c = '0' + num % 10;
+        num /= 10;
+        minDigits--;
+    }
+    return c;
+}
+
+/// @brief Copies [start, end) to the front of the buffer, null terminated
+static int finish(char* buffer, const char* start, const char* end) {
+    int len = end - start;
+    memmove(buffer, start, len);
+    buffer[len] = '\0';
+    return len;
+}
+
+int formatInt(char* buffer, int num) {
+    // digits get written backwards from the end, then moved to the front
+    char* end = buffer + formatIntLen - 1;
+    // widened first, so INT_MIN has a positive counterpart
+    Sint64 wide = num;
+    char* c = writeDigits(end, wide < 0 ? -wide : wide);
+    if (wide < 0) {
+        *--c = '-';
+    }
+    return finish(buffer, c, end);
+}
+
+int formatFloat(char* buffer, float num, int decimals) {
+    static const Uint64 pow10[] = {
+        1, 10, 100, 1000, 10000, 100000,
+        1000000, 10000000, 100000000, 1000000000,
+    };
+    decimals = clamp(decimals, 0, 9);
+    double scaled = fabs((double)num) * pow10[decimals];
+    // past 2^63 it doesn't fit in the integer we round through; also covers
+    // inf and nan
+    if (!(scaled < 9.2e18)) {
+        return snprintf(buffer, formatFloatLen, "%.*f", decimals, num);
+    }
+    // rounds ties to even, same as printf. Scaling can round too, so this
+    // isn't exactly printf's answer in every case, but it's within the last
+    // digit
+    Uint64 fixed = (Uint64)nearbyint(scaled);
+
+    char* end = buffer + formatFloatLen - 1;
+    char* c = end;
+    if (decimals > 0) {
+        c = writeDigits(c, fixed % pow10[decimals], decimals);
+        *--c = '.';
+    }
+    c = writeDigits(c, fixed / pow10[decimals]);
+    if (signbit(num)) {
+        *--c = '-';
+    }
+    return finish(buffer, c, end);
+}
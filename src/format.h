@@ -0,0 +1,48 @@
+// format.h - number to text conversion without printf
+
+#pragma once
+
+#include "common.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// big enough for any int, plus sign and null terminator
+const int formatIntLen = 12;
+// big enough for any float formatFloat writes, plus null terminator
+const int formatFloatLen = 64;
+
+/// @brief Writes `num` in decimal, like "%d" would
+/// @param buffer at least `formatIntLen` chars
+/// @return the length written, not counting the null terminator
+int formatInt(char* buffer, int num);
+
+/// @brief Writes `num` with a fixed number of decimal places, like "%.2f"
+/// would. Values too big to round through a 64-bit integer go through
+/// snprintf instead; nothing on screen is that big
+/// @param buffer at least `formatFloatLen` chars
+/// @param decimals at most 9
+/// @return the length written, not counting the null terminator
+int formatFloat(char* buffer, float num, int decimals = 2);
+
+TEST(formatNumbers, {
+    char expected[64], actual[formatFloatLen];
+    for (int num : {0, 7, -7, 10, 123456, -2147483647-1, 2147483647}) {
+        snprintf(expected, sizeof(expected), "%d", num);
+        int len = formatInt(actual, num);
+        TEST_EQ_MSG(strcmp(actual, expected), 0, "formatInt");
+        TEST_EQ(len, (int)strlen(expected));
+    }
+    for (float num : {0.0f, -0.0f, 0.5f, 0.125f, 0.005f, -0.004f, 1.999f,
+            -12.345f, 3.14159f, 1e6f, 123456.789f, 4e18f, -1e30f}) {
+        snprintf(expected, sizeof(expected), "%.2f", num);
+        int len = formatFloat(actual, num);
+        TEST_EQ_MSG(strcmp(actual, expected), 0, "formatFloat");
+        TEST_EQ(len, (int)strlen(expected));
+    }
+    snprintf(expected, sizeof(expected), "%.0f", 2.5f);
+    formatFloat(actual, 2.5f, 0);
+    TEST_EQ_MSG(strcmp(actual, expected), 0,
+        "ties round to even, like printf");
+})
@@ -0,0 +1,191 @@
+// frameScheduler.h - paces the main loop to a target frame time
+
+#pragma once
+
+#include "common.h"
+
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+enum FramePacing {
+    pacingCapped, // sleep, then spin, until the target frame time has passed
+    pacingVSync, // let SDL_RenderPresent block until vblank
+    pacingUncapped, // run as fast as possible
+};
+
+class FrameScheduler {
+    FramePacing _pacing;
+    double _targetSec;
+
+    const Uint64 _freq = SDL_GetPerformanceFrequency();
+    Uint64 _frameStart = SDL_GetPerformanceCounter();
+
+    // SDL_Delay wakes up late by some OS-dependent amount (often ~1ms, up to a
+    // whole scheduler quantum on Windows), so we track how late it runs and
+    // stop sleeping that far before the deadline, then spin the remainder.
+    // Starts pessimistic and adapts as we measure
+    double _oversleepSec = 0.002;
+
+    // with vsync, presenting is what normally holds the loop back
+    bool _presentBlocks = true;
+
+public:
+    // frame time histogram, in fixed-size buckets; the last is overflow
+    static const int numBuckets = 64;
+    static constexpr double bucketMs = 0.5;
+    int histogram[numBuckets] = {};
+    int numFrames = 0;
+    int numMissed = 0; // frames that took longer than the target
+    double worstMs = 0;
+    double lastFrameMs = 0;
+
+    /// @param pacing how to wait out the remainder of each frame
+    /// @param targetFps only used for `pacingCapped`
+    FrameScheduler(FramePacing pacing, float targetFps = 60)
+            : _pacing(pacing), _targetSec(1.0/targetFps) {
+        // vsync is a renderer creation flag; the hint makes SDL_CreateRenderer
+        // pick it up, so this needs to exist before the renderer does
+        SDL_SetHint(SDL_HINT_RENDER_VSYNC, pacing == pacingVSync ? "1" : "0");
+    }
+
+    /// @brief Parses pacing options out of the command line:
+    /// `--vsync`, `--uncapped`, or `--fps N` (capped, the default)
+    static FrameScheduler fromArgs(int argc, char** argv) {
+        FramePacing pacing = pacingCapped;
+        float fps = 60;
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--vsync") == 0) {
+                pacing = pacingVSync;
+            } else if (strcmp(argv[i], "--uncapped") == 0) {
+                pacing = pacingUncapped;
+            } else if (strcmp(argv[i], "--fps") == 0 && i+1 < argc) {
+                pacing = pacingCapped;
+                fps = atof(argv[++i]);
+                check(fps > 0, "invalid --fps %s, using 60", argv[i]);
+                if (fps <= 0) {
+                    fps = 60;
+                }
+            }
+        }
+        return FrameScheduler(pacing, fps);
+    }
+
+    /// @brief Call when presenting moves off this thread, so vsync no longer
+    /// paces it; vsync mode then waits out the target frame time instead
+    void presentingOffThread() {
+        _presentBlocks = false;
+    }
+
+    /// @brief Starts timing a new frame from now, e.g. so startup time
+    /// doesn't show up as one enormous first frame
+    void restart() {
+        _frameStart = SDL_GetPerformanceCounter();
+    }
+
+    /// @brief Call once at the end of each frame, after presenting. Waits out
+    /// the rest of the frame if needed, then records how long it took
+    void endFrame() {
+        if (_pacing == pacingCapped || (_pacing == pacingVSync && !_presentBlocks)) {
+            waitUntil(_frameStart + Uint64(_targetSec*_freq));
+        }
+
+        Uint64 now = SDL_GetPerformanceCounter();
+        lastFrameMs = 1000.0 * (now - _frameStart) / _freq;
+        _frameStart = now;
+
+        int bucket = min(int(lastFrameMs / bucketMs), numBuckets-1);
+        histogram[bucket]++;
+        numFrames++;
+        worstMs = max(worstMs, lastFrameMs);
+        // vsync and uncapped don't have a target of their own, but it's still
+        // useful to know how often we drop below the nominal rate
+        if (lastFrameMs > 1000.0*_targetSec + bucketMs) {
+            numMissed++;
+        }
+    }
+
+    /// @brief Frame time at or below which `pct` of all frames fall,
+    /// to the resolution of a histogram bucket
+    double percentileMs(float pct) const {
+        int target = ceil(pct * numFrames);
+        int seen = 0;
+        for (int i = 0; i < numBuckets; ++i) {
+            seen += histogram[i];
+            if (seen >= target) {
+                return (i+1)*bucketMs;
+            }
+        }
+        return worstMs;
+    }
+
+    void logReport() const {
+        const char* modes[] = { "capped", "vsync", "uncapped" };
+        log("frame pacing: %s, target %.2fms, %d frames", modes[_pacing],
+            1000*_targetSec, numFrames);
+        if (numFrames == 0) {
+            return;
+        }
+        log("  p50 %.1fms  p99 %.1fms  worst %.2fms  missed %d (%.1f%%)",
+            percentileMs(0.5), percentileMs(0.99), worstMs,
+            numMissed, 100.0*numMissed/numFrames);
+        // scale the bars so the biggest bucket is 60 chars wide
+        int most = 1;
+        for (int i = 0; i < numBuckets; ++i) {
+            most = max(most, histogram[i]);
+        }
+        for (int i = 0; i < numBuckets; ++i) {
+            if (histogram[i] == 0) {
+                continue;
+            }
+            char bar[61];
+            int len = max(1, 60 * histogram[i] / most);
+            memset(bar, '#', len);
+            bar[len] = '\0';
+            log("  %5.1fms%s %7d %s", i*bucketMs, i == numBuckets-1 ? "+" : " ",
+                histogram[i], bar);
+        }
+    }
+
+private:
+    void waitUntil(Uint64 deadline) {
+        // one freak wakeup (a whole timer tick, or being descheduled) mustn't
+        // leave the margin bigger than a frame's slack, or we'd never sleep
+        // again, and spin at 100% CPU from then on
+        const double maxOversleep = min(0.004, _targetSec / 4);
+        bool slept = false;
+        while (true) {
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (now >= deadline) {
+                return;
+            }
+            double remaining = double(deadline - now) / _freq;
+            if (remaining <= _oversleepSec) {
+                break;
+            }
+            // sleep coarsely, and measure how far past the request we woke up
+            Uint32 sleepMs = Uint32(1000 * (remaining - _oversleepSec));
+            if (sleepMs == 0) {
+                break;
+            }
+            SDL_Delay(sleepMs);
+            slept = true;
+            double sleptSec = double(SDL_GetPerformanceCounter() - now) / _freq;
+            double over = min(sleptSec - sleepMs/1000.0, maxOversleep);
+            // rise quickly when we oversleep, decay slowly when we don't
+            if (over > _oversleepSec) {
+                _oversleepSec = over;
+            } else {
+                _oversleepSec = lerp(0.05f, _oversleepSec, max(over, 0.0002));
+            }
+        }
+        if (!slept) {
+            // all spin, so nothing measured; drift back down, so a margin
+            // that's grown too big for the slack we have gets to sleep again
+            _oversleepSec = max(0.0002, _oversleepSec * 0.98);
+        }
+        // spin out the last stretch
+        while (SDL_GetPerformanceCounter() < deadline) {
+        }
+    }
+};
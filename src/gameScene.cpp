@@ -1,7 +1,7 @@
 #include "gameScene.h"
 
 Entity::Entity(Vec3 pos, Vec3 vel, Vec2 size)
-    : _pos(pos), _vel(vel), _size(size) {
+    : _pos(pos), _vel(vel), _size(size), _lastPos(pos) {
 }
 
 /// @brief Helper function; projects worldspace to screenspace
@@ -9,16 +9,30 @@ Vec2 project(Vec3 v) {
     return { v.x, v.y*0.5f + v.z};
 }
 
-void Entity::render(Renderer* renderer) {
-    renderer->drawRect(project(_pos), _size);
+void Entity::render(Renderer* renderer, float alpha) {
+    renderer->drawRect(project(renderPos(alpha)), _size);
 }
 
+Vec3 Entity::renderPos(float alpha) const {
+    return lerp(alpha, _lastPos, _pos);
+}
+
+Rect Entity::footprint() const {
+    return { _pos.xy(), _size };
+}
+
+static const Vec2 bulletSize {20, 20};
+
 Bullet::Bullet(Vec3 pos, Vec3 vel, float lifespan)
-    : Entity(pos, vel, {20, 20}),
+    : Entity(pos, vel, bulletSize),
     _lifespan(lifespan), _lived(0) {
 }
 
+Bullet::Bullet() : Bullet({}, {}, 0) {
+}
+
 void Bullet::update(float dt) {
+    _lastPos = _pos;
     _pos += dt*_vel;
     _lived += dt;
 }
@@ -36,6 +50,22 @@ bool Bullet::shouldRemove() const {
     return false;
 }
 
+Enemy::Enemy(Vec3 pos) : Entity(pos, {0, 0}, {40, 60}), _hp(3) {
+}
+
+Enemy::Enemy() : Enemy(Vec3 {}) {
+}
+
+void Enemy::update(float dt) {
+    // target dummies, they just stand there
+    _lastPos = _pos;
+}
+
+void Enemy::render(Renderer* renderer, float alpha) {
+    renderer->setColor(lerp(_hp/3.0f, Color::red, Color::white));
+    Entity::render(renderer, alpha);
+}
+
 Player::Player() : Entity(
     /*pos*/ {300, groundY},
     /*vel*/ {0, 0},
@@ -48,9 +78,10 @@ void Player::update(float dt) {
     const float gravity = 2000;
     float jumpHeight = 150;
 
+    _lastPos = _pos;
     _spinT += dt;
 
-    _headingDir = {_input->getAxis("horizontal"), _input->getAxis("vertical")};
+    _headingDir = {_input->getAxis("horizontal"_action), _input->getAxis("vertical"_action)};
     if (_headingDir != Vec2 {0}) {
         _aimingDir = _headingDir;
     }
@@ -71,12 +102,12 @@ void Player::update(float dt) {
     }
     
     _vel.z += gravity*dt;
-    if (_input->didPress("jump") && _isOnGround) {
+    if (_input->didPress("jump"_action) && _isOnGround) {
         _vel.z = -sqrt(2*gravity*jumpHeight);
         _isOnGround = false;
     }
     // reduce jump speed on release, gives control of jump height
-    if (_input->didRelease("jump") && _vel.z < 0) {
+    if (_input->didRelease("jump"_action) && _vel.z < 0) {
         _vel.z = 0.3*_vel.z;
     }
 
@@ -88,25 +119,27 @@ void Player::update(float dt) {
     }
 }
 
-void Player::render(Renderer* renderer) {
+void Player::render(Renderer* renderer, float alpha) {
+    Vec3 pos = renderPos(alpha);
+
     // shadow (draws first because it's in the background)
     renderer->setColor(0.2, 0.2, 0.2, 1);
     float shadow = 10;
-    renderer->drawRect(project(_pos.xy()) + Vec2 {-shadow, _size.y-shadow},
+    renderer->drawRect(project(pos.xy()) + Vec2 {-shadow, _size.y-shadow},
         {_size.x + 2*shadow, 2*shadow});
 
     // player
     renderer->setColor(0, 1, 1, 1);
-    renderer->drawRect(project(_pos), _size);
+    renderer->drawRect(project(pos), _size);
 
     // spinny widget
     renderer->setColor(1, 0, 1, 1);
-    renderer->drawRect(project(widgetPos()), {25,25});
+    renderer->drawRect(project(pos + widgetPos() - _pos), {25,25});
 
     // debug input reticle
     renderer->setColor(1, 0, 0, 1);
     const Vec2 reticleSize {16};
-    renderer->drawRect(project(_pos)
+    renderer->drawRect(project(pos)
             + 100.0f*_headingDir
             + (_size-reticleSize)/2,
         reticleSize);
@@ -118,15 +151,67 @@ Vec3 Player::widgetPos() const {
 
 GameScene::GameScene(Input* input, TexGen *texGen, TexGenScene* texScene) :
     _input(input), _texGen(texGen), _texScene(texScene) {
+    spawnEnemies();
+}
+
+Uint32 GameScene::saveState(BinaryWriter &out) const {
+    return writeRecord(out, *this);
+}
+
+void GameScene::loadState(const BinaryRecord &record) {
+    // replaces the enemies the constructor spawned
+    readRecord(record, *this);
+}
+
+void GameScene::spawnEnemies() {
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            _enemies.push_back(Enemy({1300.0f + 120*i, groundY - 150 + 100*j}));
+        }
+    }
+}
+
+void GameScene::collideBullets(float dt) {
+    // bullets move fast enough to tunnel through an enemy in a single step,
+    // so rather than test overlap we cast each bullet's center along its
+    // velocity, against enemy bounds grown by half a bullet on each side
+    _enemyBounds.clear();
+    for (auto &enemy : _enemies) {
+        Rect r = enemy.footprint();
+        _enemyBounds.push_back({r.pos - bulletSize/2, r.size + bulletSize});
+    }
+    _enemyHash.build(_enemyBounds);
+
+    for (auto &bullet : _bullets) {
+        Rect r = bullet.footprint();
+        SpatialHash::RayHit hit;
+        if (_enemyHash.raycast(r.pos + r.size/2, dt*bullet._vel.xy(), hit)) {
+            _enemies[hit.item]._hp--;
+            // expire the bullet so it gets cleaned up with the rest
+            bullet._lived = bullet._lifespan;
+        }
+    }
+
+    for (int i = _enemies.size() - 1; i >= 0; --i) {
+        if (_enemies[i]._hp <= 0) {
+            std::swap(_enemies[i], _enemies.back());
+            _enemies.pop_back();
+        }
+    }
+    if (_enemies.empty()) {
+        spawnEnemies();
+    }
 }
 
 void GameScene::update(float dt) {
-    if (_input->didPress("shoot")) {
+    if (_input->didPress("shoot"_action)) {
         Vec2 vel = 2000.0f * _player._aimingDir;
         Bullet bullet {_player.widgetPos(), vel, 1.5};
         _bullets.push_back(bullet);
     }
 
+    collideBullets(dt);
+
     int numToRemove = 0;
     for (int i = _bullets.size() - 1; i >= 0; --i) {
         auto& bullet = _bullets[i];
@@ -150,6 +235,7 @@ void GameScene::render(Renderer* renderer) {
     tileSize.y /= 2;
     int w = ceil(screenSize.x/tileSize.x);
     int h = ceil(screenSize.y/tileSize.y);
+    renderer->setLayer(layerBackground);
     for (int i = 0; i < w; ++i) {
         for (int j = 0; j < h; ++j) {
             renderer->drawImage(_texGen->textureForIndex(i + j*w),
@@ -157,13 +243,18 @@ void GameScene::render(Renderer* renderer) {
                 tileSize);
         }
     }
+    renderer->setLayer(layerWorld);
+
+    for (auto& enemy : _enemies) {
+        enemy.render(renderer, renderAlpha);
+    }
 
     renderer->setColor(1, 1, 0, 1);
     for (auto& bullet : _bullets) {
-        bullet.render(renderer);
+        bullet.render(renderer, renderAlpha);
     }
 
-    _player.render(renderer);
+    _player.render(renderer, renderAlpha);
 
     renderer->drawText("Did everything go", 1100, 145);
     renderer->drawText("better than expected?", 1140, 190);
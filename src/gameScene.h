@@ -4,15 +4,16 @@
 
 #include "common.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "scene.h"
+#include "serialize.h"
+#include "spatialHash.h"
 #include "texGenScene.h"
 #include "vec.h"
 
 #include <math.h>
 #include <vector>
 
-const Vec2 screenSize { 1920, 1080 };
 const float groundHeight = 250;
 const float groundY = screenSize.y - groundHeight;
 
@@ -20,11 +21,18 @@ struct Entity {
     Vec3 _pos;
     Vec3 _vel;
     Vec2 _size;
+    Vec3 _lastPos; // position as of the previous update, for interpolation
 
     Entity(Vec3 pos, Vec3 vel, Vec2 size);
 
     virtual void update(float dt) = 0;
-    virtual void render(Renderer* renderer);
+    virtual void render(Renderer* renderer, float alpha);
+
+    /// @brief Position to draw at, `alpha` of the way from the last update
+    Vec3 renderPos(float alpha) const;
+
+    /// @brief Bounds projected onto the ground plane, ignoring height
+    Rect footprint() const;
 };
 
 struct Bullet : public Entity {
@@ -32,11 +40,22 @@ struct Bullet : public Entity {
     float _lived;
 
     Bullet(Vec3 pos, Vec3 vel, float lifespan);
+    Bullet(); // to load saved state into
 
     void update(float dt) override;
     bool shouldRemove() const;
 };
 
+struct Enemy : public Entity {
+    int _hp;
+
+    Enemy(Vec3 pos);
+    Enemy(); // to load saved state into
+
+    void update(float dt) override;
+    void render(Renderer* renderer, float alpha) override;
+};
+
 struct Player : public Entity {
     bool _isOnGround = false;
     float _spinT = 0.0;
@@ -49,7 +68,7 @@ struct Player : public Entity {
     Player();
 
     void update(float dt) override;
-    void render(Renderer* renderer) override;
+    void render(Renderer* renderer, float alpha) override;
 
     Vec3 widgetPos() const;
 };
@@ -57,6 +76,11 @@ struct Player : public Entity {
 class GameScene : public Scene {
     Player _player;
     std::vector<Bullet> _bullets;
+    std::vector<Enemy> _enemies;
+
+    // broadphase for bullet collisions, rebuilt each frame
+    SpatialHash _enemyHash;
+    std::vector<Rect> _enemyBounds;
 
     Input* _input;
     TexGen* _texGen;
@@ -65,6 +89,61 @@ class GameScene : public Scene {
 public:
     GameScene(Input* input, TexGen *texGen, TexGenScene* texScene);
 
+    Uint32 saveState(BinaryWriter &out) const override;
+    void loadState(const BinaryRecord &record) override;
+
     void update(float dt) override;
     void render(Renderer* renderer) override;
+
+private:
+    friend struct SerialFields<GameScene>;
+
+    void spawnEnemies();
+    void collideBullets(float dt);
+};
+
+// entities have vtables, so they're saved field by field, never copied whole
+
+/// @brief What every Entity saves, for its subclasses' SerialFields
+constexpr auto entityFields = std::make_tuple(
+    serialField("pos", &Entity::_pos),
+    serialField("vel", &Entity::_vel),
+    serialField("size", &Entity::_size),
+    serialField("lastPos", &Entity::_lastPos));
+
+template <>
+struct SerialFields<Bullet> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::tuple_cat(entityFields,
+        std::make_tuple(
+            serialField("lifespan", &Bullet::_lifespan),
+            serialField("lived", &Bullet::_lived)));
+};
+
+template <>
+struct SerialFields<Enemy> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::tuple_cat(entityFields,
+        std::make_tuple(serialField("hp", &Enemy::_hp)));
+};
+
+// not `_input`, which the scene sets each update
+template <>
+struct SerialFields<Player> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::tuple_cat(entityFields,
+        std::make_tuple(
+            serialField("isOnGround", &Player::_isOnGround),
+            serialField("spinT", &Player::_spinT),
+            serialField("headingDir", &Player::_headingDir),
+            serialField("aimingDir", &Player::_aimingDir)));
+};
+
+template <>
+struct SerialFields<GameScene> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("player", &GameScene::_player),
+        serialField("bullets", &GameScene::_bullets),
+        serialField("enemies", &GameScene::_enemies));
 };
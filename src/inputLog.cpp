@@ -0,0 +1,230 @@
+#include "inputLog.h"
+
+#include <string.h>
+
+// tags starting each record
+static const Uint8 tagFrame = 'F'; // then a float: the frame time
+static const Uint8 tagEvent = 'E'; // then a byte count and that much SDL_Event
+static const Uint8 tagStep = 'S'; // Input::update finished
+
+static const char magic[4] = {'S', 'C', 'I', 'L'};
+static const Uint32 version = 1;
+// recorded events are flushed once there's this much of them
+static const size_t flushSize = 64 << 10;
+
+struct InputLogHeader {
+    char magic[4];
+    Uint32 version;
+    // events are stored raw, so they only make sense to the same build of SDL
+    Uint32 eventSize;
+};
+
+/// @brief How much of an event of this type is worth keeping; anything we
+/// don't know the layout of keeps all of it
+static Uint8 eventSize(Uint32 type) {
+    switch (type) {
+    case SDL_QUIT: return sizeof(SDL_CommonEvent);
+    case SDL_WINDOWEVENT: return sizeof(SDL_WindowEvent);
+    case SDL_KEYDOWN:
+    case SDL_KEYUP: return sizeof(SDL_KeyboardEvent);
+    case SDL_MOUSEMOTION: return sizeof(SDL_MouseMotionEvent);
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP: return sizeof(SDL_MouseButtonEvent);
+    case SDL_CONTROLLERAXISMOTION: return sizeof(SDL_ControllerAxisEvent);
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP: return sizeof(SDL_ControllerButtonEvent);
+    default: return sizeof(SDL_Event);
+    }
+}
+
+InputLog::~InputLog() {
+    close();
+}
+
+bool InputLog::startRecording(const char* filename) {
+    _file = fopen(filename, "wb");
+    if (!check(_file, "couldn't open %s to record input", filename)) {
+        return false;
+    }
+    InputLogHeader header {{}, version, sizeof(SDL_Event)};
+    memcpy(header.magic, magic, sizeof(magic));
+    write(&header, sizeof(header));
+    _mode = logRecording;
+    _startTicks = SDL_GetPerformanceCounter();
+    return true;
+}
+
+bool InputLog::startReplay(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!check(file, "couldn't open input log %s", filename)) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    _data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    size_t got = fread(_data.data(), 1, _data.size(), file);
+    fclose(file);
+
+    InputLogHeader header;
+    _readPos = 0;
+    if (!check(got == _data.size() && read(&header, sizeof(header))
+            && memcmp(header.magic, magic, sizeof(magic)) == 0,
+            "%s isn't an input log", filename)
+        || !check(header.version == version && header.eventSize == sizeof(SDL_Event),
+            "%s is from an incompatible build (version %d, %d byte events)",
+            filename, header.version, header.eventSize)) {
+        _data.clear();
+        return false;
+    }
+    _mode = logReplaying;
+    _startTicks = SDL_GetPerformanceCounter();
+    return true;
+}
+
+void InputLog::close() {
+    if (_file) {
+        flush();
+        fclose(_file);
+        _file = nullptr;
+    }
+}
+
+InputLogMode InputLog::mode() const {
+    return _mode;
+}
+
+bool InputLog::finished() const {
+    return _finished;
+}
+
+float InputLog::frameTime(float realDt) {
+    if (_mode == logRecording) {
+        write(&tagFrame, 1);
+        write(&realDt, sizeof(realDt));
+        if (_data.size() >= flushSize) {
+            flush();
+        }
+    } else if (_mode == logReplaying) {
+        resync(tagFrame);
+        Uint8 tag;
+        if (!read(&tag, 1) || !read(&realDt, sizeof(realDt))) {
+            _finished = true;
+            return 0;
+        }
+    } else {
+        return realDt;
+    }
+    _frames++;
+    _loggedSec += realDt;
+    return realDt;
+}
+
+int InputLog::pollEvent(SDL_Event* event) {
+    if (_mode != logReplaying) {
+        int got = SDL_PollEvent(event);
+        if (got && _mode == logRecording) {
+            Uint8 size = eventSize(event->type);
+            write(&tagEvent, 1);
+            write(&size, 1);
+            write(event, size);
+        }
+        return got;
+    }
+
+    if (_readPos >= _data.size() || _data[_readPos] != tagEvent) {
+        return 0;
+    }
+    Uint8 tag, size;
+    memset(event, 0, sizeof(*event));
+    if (!read(&tag, 1) || !read(&size, 1)) {
+        _finished = true;
+        return 0;
+    }
+    // the size comes from the file, and anything bigger than an event would
+    // write past this one
+    if (size > sizeof(*event)) {
+        check(false, "replay corrupt at frame %d: %d-byte event", _frames, size);
+        _finished = true;
+        return 0;
+    }
+    if (!read(event, size)) {
+        _finished = true;
+        return 0;
+    }
+    return 1;
+}
+
+void InputLog::endStep() {
+    if (_mode == logRecording) {
+        write(&tagStep, 1);
+    } else if (_mode == logReplaying) {
+        resync(tagStep);
+        Uint8 tag;
+        read(&tag, 1);
+        // nobody's reading SDL's events, but the window still needs them
+        // pumped to stay responsive
+        SDL_PumpEvents();
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+    }
+}
+
+void InputLog::logReport() const {
+    if (_mode == logOff) {
+        return;
+    }
+    if (_mode == logRecording) {
+        log("input log: recorded %d frames, %.2fs of input", _frames, _loggedSec);
+        return;
+    }
+    double wallSec = double(SDL_GetPerformanceCounter() - _startTicks)
+        / SDL_GetPerformanceFrequency();
+    log("input log: replayed %d frames, %.2fs of input in %.2fs (%.1fx)%s",
+        _frames, _loggedSec, wallSec, wallSec > 0 ? _loggedSec / wallSec : 0,
+        _desynced ? ", desynced" : "");
+}
+
+void InputLog::write(const void* data, size_t size) {
+    const Uint8* bytes = (const Uint8*)data;
+    _data.insert(_data.end(), bytes, bytes + size);
+}
+
+bool InputLog::read(void* data, size_t size) {
+    if (_readPos + size > _data.size()) {
+        return false;
+    }
+    memcpy(data, &_data[_readPos], size);
+    _readPos += size;
+    return true;
+}
+
+void InputLog::resync(Uint8 tag) {
+    if (_readPos >= _data.size() || _data[_readPos] == tag) {
+        return;
+    }
+    if (!_desynced) {
+        check(false, "replay desynced at frame %d: expected '%c', got '%c'",
+            _frames, tag, _data[_readPos]);
+        _desynced = true;
+    }
+    while (_readPos < _data.size() && _data[_readPos] != tag) {
+        Uint8 skipped = _data[_readPos++];
+        if (skipped == tagFrame) {
+            _readPos += sizeof(float);
+        } else if (skipped == tagEvent && _readPos < _data.size()) {
+            if (_data[_readPos] > sizeof(SDL_Event)) {
+                // no telling where the next record starts; give up on the
+                // rest, which finishes the replay on the next read
+                _readPos = _data.size();
+                return;
+            }
+            _readPos += 1 + _data[_readPos];
+        }
+    }
+}
+
+void InputLog::flush() {
+    if (_file && !_data.empty()) {
+        fwrite(_data.data(), 1, _data.size(), _file);
+        _data.clear();
+    }
+}
@@ -0,0 +1,74 @@
+// inputLog.h - records SDL events and frame times, and plays them back
+
+#pragma once
+
+#include "common.h"
+
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+enum InputLogMode {
+    logOff, // events come straight from SDL
+    logRecording, // they come from SDL, and get written down
+    logReplaying, // they come from the log, and SDL's get dropped
+};
+
+/// @brief A session's input, as a binary log: per frame, the time it took,
+/// then the SDL events Input saw that frame. Replaying feeds those
+/// same events and frame times back in, so the simulation takes the same
+/// steps with the same input, however fast frames actually run.
+///
+/// Owned by the kernel, which records frame times, and handed to game.dll,
+/// whose Input polls events through it. Nothing virtual, so it survives
+/// reloads like the Renderer does
+class InputLog {
+    InputLogMode _mode = logOff;
+    FILE* _file = nullptr; // when recording
+    std::vector<Uint8> _data; // recorded but not flushed yet, or the replay
+    size_t _readPos = 0;
+    bool _finished = false;
+    bool _desynced = false;
+
+    int _frames = 0;
+    double _loggedSec = 0; // sum of frame times, as recorded
+    Uint64 _startTicks = 0;
+
+public:
+    ~InputLog();
+
+    /// @return false if the file couldn't be opened
+    bool startRecording(const char* filename);
+    /// @return false if the file couldn't be read, or isn't an input log
+    bool startReplay(const char* filename);
+    /// @brief Writes out anything still buffered, and stops recording
+    void close();
+
+    InputLogMode mode() const;
+    /// @brief Whether a replay has run out of frames
+    bool finished() const;
+
+    /// @brief Called by the kernel at the start of each frame
+    /// @param realDt seconds since the last frame
+    /// @return the frame time to simulate: `realDt`, or the recorded one
+    /// when replaying
+    float frameTime(float realDt);
+
+    /// @brief Stands in for SDL_PollEvent in Input::update
+    /// @return 1 if there was an event, otherwise 0
+    int pollEvent(SDL_Event* event);
+    /// @brief Called at the end of each Input::update, after the last
+    /// pollEvent
+    void endStep();
+
+    /// @brief Logs how much time the log covered against how long it took
+    void logReport() const;
+
+private:
+    void write(const void* data, size_t size);
+    bool read(void* data, size_t size);
+    /// @brief Skips ahead to the next record with the given tag, complaining
+    /// once that the replay no longer matches what was recorded
+    void resync(Uint8 tag);
+    void flush();
+};
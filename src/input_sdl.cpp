@@ -1,13 +1,63 @@
 #include "input_sdl.h"
 
+#include <string.h>
+
 using namespace std::literals;
 
+void ActionTable::clear() {
+    _hashes.clear();
+    _names.clear();
+    memset(_slots, 0, sizeof(_slots));
+}
+
+int ActionTable::intern(InputAction action) {
+    int index = find(action);
+    if (index >= 0) {
+        // two names sharing a hash would silently share state
+        assert(_names[index] == action.name,
+            "actions \"%s\" and \"%s\" have the same hash",
+            _names[index].c_str(), action.name);
+        return index;
+    }
+    assert(_hashes.size() < numSlots/2, "too many actions to intern \"%s\"",
+        action.name);
+    index = _hashes.size();
+    _hashes.push_back(action.hash);
+    _names.push_back(action.name);
+    Uint32 slot = action.hash;
+    while (_slots[slot % numSlots]) {
+        slot++;
+    }
+    _slots[slot % numSlots] = index + 1;
+    return index;
+}
+
+int ActionTable::find(InputAction action) const {
+    for (Uint32 slot = action.hash; ; slot++) {
+        int entry = _slots[slot % numSlots];
+        if (entry == 0) {
+            return -1;
+        }
+        if (_hashes[entry-1] == action.hash) {
+            return entry-1;
+        }
+    }
+}
+
+int ActionTable::size() const {
+    return _hashes.size();
+}
+
+const char* ActionTable::name(int index) const {
+    return _names[index].c_str();
+}
+
 // call once per frame
 void Input::update() {
     Tracer trace("Input::update");
     // clear just-pressed bit, so JustPressed -> Pressed and JustReleased -> Released
-    for (auto& kv : _buttons) {
-        kv.second.lastPressed = kv.second.pressed;
+    for (auto &button : _buttons) {
+        button.lastPressed = button.pressed;
     }
     trace("updated %d buttons", _buttons.size());
 
@@ -16,21 +66,22 @@ void Input::update() {
 
     // poll for new events and update button mappings
     SDL_Event event;
-    while (SDL_PollEvent(&event)) {
+    while (_log ? _log->pollEvent(&event) : SDL_PollEvent(&event)) {
         trace("event type=%d", event.type);
         switch (event.type) {
         case SDL_WINDOWEVENT: {
             if (event.window.event == SDL_WINDOWEVENT_CLOSE) {
-                _buttons["quit"].pressed = true;
+                _buttons[addButton("quit")].pressed = true;
             }
             break;
         }
         case SDL_QUIT: {
-            _buttons["quit"].pressed = true;
+            _buttons[addButton("quit")].pressed = true;
             break;
         }
         case SDL_KEYDOWN:
         case SDL_KEYUP: {
+            noteInput(event.key.timestamp);
             bool isPress = event.type == SDL_KEYDOWN;
             auto sym = event.key.keysym.sym;
             if (isPress) {
@@ -52,11 +103,15 @@ void Input::update() {
             break;
         }
         case SDL_MOUSEMOTION: {
+            if (event.motion.timestamp > _motionSampledAt) {
+                noteInput(event.motion.timestamp);
+            }
             _mousePos = Vec2i { event.motion.x, event.motion.y }.to<float>();
             break;
         }
         case SDL_MOUSEBUTTONDOWN:
         case SDL_MOUSEBUTTONUP: {
+            noteInput(event.button.timestamp);
             bool isPress = event.type == SDL_MOUSEBUTTONDOWN;
             auto btn = event.button.button;
             auto it = _mousebinds.find(btn);
@@ -66,6 +121,7 @@ void Input::update() {
             break;
         }
         case SDL_CONTROLLERAXISMOTION: {
+            noteInput(event.caxis.timestamp);
             auto it = _ctrlaxes.find(event.caxis.axis);
             if (it != _ctrlaxes.end()) {
                 float v = (float)event.caxis.value / __INT16_MAX__;
@@ -80,6 +136,7 @@ void Input::update() {
         }
         case SDL_CONTROLLERBUTTONDOWN:
         case SDL_CONTROLLERBUTTONUP: {
+            noteInput(event.cbutton.timestamp);
             bool isPress = event.type == SDL_CONTROLLERBUTTONDOWN;
             auto btn = event.cbutton.button;
             auto it = _ctrlbinds.find(btn);
@@ -91,22 +148,88 @@ void Input::update() {
         }
         }
     }
+    if (_log) {
+        _log->endStep();
+    }
+    _cursorPos = _mousePos;
 
     if (!_usingController) {
-        for (auto &axis: _axes) {
-            auto pair = _pairaxes[axis.first];
-            float v = isHeld(pair.pos) - isHeld(pair.neg);
-            axis.second.value = v;
+        auto held = [&](int index) {
+            return index >= 0
+                && (_buttons[index].lastPressed || _buttons[index].pressed);
+        };
+        for (auto &axis : _axes) {
+            axis.value = held(axis.pos) - held(axis.neg);
         }
     }
 }
 
-// clear button mappings
+void Input::resample() {
+    // a replay's cursor comes from the log, not wherever the real mouse is
+    if (replaying()) {
+        return;
+    }
+    SDL_PumpEvents();
+    // peeked rather than taken, so the next update still sees it; all we
+    // want is its timestamp, since SDL's mouse state already includes it
+    SDL_Event motion;
+    if (SDL_PeepEvents(&motion, 1, SDL_PEEKEVENT,
+            SDL_MOUSEMOTION, SDL_MOUSEMOTION) == 1) {
+        noteInput(motion.motion.timestamp);
+        int x, y;
+        SDL_GetMouseState(&x, &y);
+        _cursorPos = Vec2i { x, y }.to<float>();
+        _motionSampledAt = SDL_GetTicks();
+    }
+}
+
+void Input::beginStep() {
+    _inStep = true;
+}
+
+void Input::endStep() {
+    for (int i = 0; i < _buttons.size(); ++i) {
+        _stepPressed[i] = _buttons[i].pressed;
+    }
+    _inStep = false;
+}
+
+Uint32 Input::takeInputTimestamp() {
+    Uint32 timestamp = _inputTimestamp;
+    _inputTimestamp = 0;
+    return timestamp;
+}
+
+bool Input::replaying() const {
+    return _log && _log->mode() == logReplaying;
+}
+
+void Input::noteInput(Uint32 timestamp) {
+    // replayed timestamps are from whenever it was recorded
+    if (replaying() || timestamp == 0) {
+        return;
+    }
+    if (_inputTimestamp == 0 || timestamp < _inputTimestamp) {
+        _inputTimestamp = timestamp;
+    }
+}
+
+void Input::setLog(InputLog* log) {
+    _log = log;
+}
+
+// clear button and axis mappings
 void Input::resetBindings() {
+    // axes refer to buttons by index, so they have to go too
+    _buttonIds.clear();
     _buttons.clear();
+    _stepPressed.clear();
+    _axisIds.clear();
+    _axes.clear();
     _keybinds.clear();
     _mousebinds.clear();
     _ctrlbinds.clear();
+    _ctrlaxes.clear();
 
     // reset previous controller state if any
     if (_controller) {
@@ -118,42 +241,49 @@ void Input::resetBindings() {
     }
 }
 
-void Input::addKeybind(std::string name, SDL_Keycode key) {
-    Tracer trace((std::string("Input::addKeybind-")+name).c_str());
-    _keybinds[key] = name;
-    if (_buttons.find(name) == _buttons.end()) {
-        trace("adding to _buttons");
-        _buttons[name] = {false, false};
+int Input::addButton(InputAction name) {
+    int index = _buttonIds.intern(name);
+    if (index == _buttons.size()) {
+        _buttons.push_back({false, false});
+        _stepPressed.push_back(false);
     }
+    return index;
 }
-void Input::addMouseBind(std::string name, int mouseButton) {
-    Tracer trace((std::string("Input::addMouseBind-")+name).c_str());
-    _mousebinds[mouseButton] = name;
-    if (_buttons.find(name) == _buttons.end()) {
-        trace("adding to _buttons");
-        _buttons[name] = {false, false};
+int Input::addAxis(InputAction name) {
+    int index = _axisIds.intern(name);
+    if (index == _axes.size()) {
+        _axes.push_back({0, Key});
     }
+    return index;
 }
-void Input::addControllerBind(std::string name, int ctrlButton) {
-    Tracer trace((std::string("Input::addControllerBind-")+name).c_str());
-    _ctrlbinds[ctrlButton] = name;
-    if (_buttons.find(name) == _buttons.end()) {
-        trace("adding to _buttons");
-        _buttons[name] = {false, false};
-    }
+
+void Input::addKeybind(InputAction name, SDL_Keycode key) {
+    _keybinds[key] = addButton(name);
+}
+void Input::addMouseBind(InputAction name, int mouseButton) {
+    _mousebinds[mouseButton] = addButton(name);
+}
+void Input::addControllerBind(InputAction name, int ctrlButton) {
+    _ctrlbinds[ctrlButton] = addButton(name);
 }
 
 Vec2 Input::getMousePos() const {
     return _mousePos;
 }
+Vec2 Input::getCursorPos() const {
+    return _cursorPos;
+}
 
-ButtonState Input::getButtonState(std::string name) const {
-    Tracer((std::string("Input::getButtonState-")+name).c_str());
-    if (_buttons.find(name) == _buttons.end()) {
-        log_once("Unknown button name: \"%s\"", name.c_str());
+ButtonState Input::getButtonState(InputAction name) const {
+    int index = _buttonIds.find(name);
+    if (index < 0) {
+        log_once("Unknown button name: \"%s\"", name.name);
         return { false, false };
     }
-    return _buttons.at(name);
+    if (_inStep) {
+        return { _stepPressed[index], _buttons[index].pressed };
+    }
+    return _buttons[index];
 }
 
 void Input::editText(std::string &text) const {
@@ -164,39 +294,35 @@ void Input::editText(std::string &text) const {
 }
 
 // returns true iff the Action was pressed this frame
-bool Input::didPress(std::string name) const {
+bool Input::didPress(InputAction name) const {
     auto state = getButtonState(name);
     return state.pressed && !state.lastPressed;
 }
 // returns true when the Action is held down
-bool Input::isHeld(std::string name) const {
+bool Input::isHeld(InputAction name) const {
     auto state = getButtonState(name);
     return state.lastPressed || state.pressed;
 }
 // returns true iff the Action was released this frame
-bool Input::didRelease(std::string name) const {
+bool Input::didRelease(InputAction name) const {
     auto state = getButtonState(name);
     return !state.pressed && state.lastPressed;
 }
 
-void Input::addAxisPair(std::string axis, std::string neg, std::string pos) {
-    assert(_buttons.find(neg) != _buttons.end(),
-        "Unknown button: \"%s\"", neg.c_str());
-    assert(_buttons.find(pos) != _buttons.end(),
-        "Unknown button: \"%s\"", pos.c_str());
-    _pairaxes[axis] = { neg, pos };
-    if (_axes.find(axis) == _axes.end()) {
-        _axes[axis] = { 0, Key };
-    }
+void Input::addAxisPair(InputAction axis, InputAction neg, InputAction pos) {
+    int negIndex = _buttonIds.find(neg);
+    int posIndex = _buttonIds.find(pos);
+    assert(negIndex >= 0, "Unknown button: \"%s\"", neg.name);
+    assert(posIndex >= 0, "Unknown button: \"%s\"", pos.name);
+    int index = addAxis(axis);
+    _axes[index].neg = negIndex;
+    _axes[index].pos = posIndex;
 }
-void Input::addControllerAxis(std::string name, Uint8 axis) {
-    _ctrlaxes[axis] = name;
-    if (_axes.find(name) == _axes.end()) {
-        _axes[name] = { 0, Key };
-    }
+void Input::addControllerAxis(InputAction name, Uint8 axis) {
+    _ctrlaxes[axis] = addAxis(name);
 }
-float Input::getAxis(std::string name) const {
-    assert(_axes.find(name) != _axes.end(),
-        "Unknown axis name: \"%s\"", name.c_str());
-    return _axes.at(name).value;
+float Input::getAxis(InputAction name) const {
+    int index = _axisIds.find(name);
+    assert(index >= 0, "Unknown axis name: \"%s\"", name.name);
+    return _axes[index].value;
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "bench.h"
 #include "common.h"
+#include "inputLog.h"
 #include "vec.h"
 
 #include <map>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include <SDL2/SDL.h>
 
@@ -13,11 +17,79 @@ struct ButtonState {
     bool pressed = false;
 };
 
+/// @brief 32-bit FNV-1a, usable at compile time
+constexpr Uint32 actionHash(const char* name) {
+    Uint32 hash = 2166136261u;
+    for (; *name; ++name) {
+        hash = (hash ^ Uint8(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+/// @brief Names an action or axis by its hash. Write literals as
+/// `"jump"_action` to hash them at compile time; plain strings and
+/// std::strings convert too, and get hashed on every call
+struct InputAction {
+    const char* name; // for error messages; only valid during the call
+    Uint32 hash;
+
+    constexpr InputAction(const char* name, Uint32 hash)
+        : name(name), hash(hash) {}
+    constexpr InputAction(const char* name)
+        : name(name), hash(actionHash(name)) {}
+    InputAction(const std::string &name)
+        : name(name.c_str()), hash(actionHash(name.c_str())) {}
+};
+
+template <char ...chars>
+constexpr char actionName[] = {chars..., '\0'};
+
+/// @brief A compile-time hashed action name, e.g. `"jump"_action`. The
+/// string literal operator template is a GNU extension, but it's the only way
+/// in C++17 to get a hash that's a constant even in unoptimized builds
+template <typename Char, Char ...chars>
+constexpr InputAction operator""_action() {
+    return InputAction(actionName<chars...>,
+        std::integral_constant<Uint32, actionHash(actionName<chars...>)>::value);
+}
+
+/// @brief Interns names to dense indices, so per-action state can live in
+/// flat arrays. Lookups go through a small open-addressed table of hashes
+class ActionTable {
+    std::vector<Uint32> _hashes; // by index
+    std::vector<std::string> _names;
+    // index+1 of whatever hashed there, 0 if empty; far more slots than
+    // there'll ever be actions, so probes stay short
+    static const int numSlots = 256;
+    Uint16 _slots[numSlots] = {};
+
+public:
+    void clear();
+    /// @brief Finds the action's index, adding it if it's new
+    int intern(InputAction action);
+    /// @return the action's index, or -1 if it was never interned
+    int find(InputAction action) const;
+    int size() const;
+    const char* name(int index) const;
+};
+
 class Input {
     Vec2 _mousePos;
-
-    // button name -> state mapping for Actions
-    std::map<std::string, ButtonState> _buttons;
+    // _mousePos, or newer if it's been resampled since the last update
+    Vec2 _cursorPos;
+    // SDL timestamp of the oldest input not yet handed to the renderer, or
+    // 0 if there's none
+    Uint32 _inputTimestamp = 0;
+    // motion up to this SDL timestamp is already counted, by `resample`
+    Uint32 _motionSampledAt = 0;
+
+    // state per Action, indexed by `_buttonIds`
+    ActionTable _buttonIds;
+    std::vector<ButtonState> _buttons;
+    // whether each button was pressed as of the last simulation step, so
+    // edges reach the simulation once however many steps a frame takes
+    std::vector<bool> _stepPressed;
+    bool _inStep = false;
 
     enum InputKind {
         Key,
@@ -28,55 +100,126 @@ class Input {
     struct Axis {
         float value;
         InputKind lastSet;
+        // buttons for either direction, if any; see addAxisPair
+        int neg = -1, pos = -1;
     };
-    // axis name -> value per input axis
-    std::map<std::string, Axis> _axes;
-
-    // keycode -> button name
-    std::map<SDL_Keycode, std::string> _keybinds;
-    // mouse button -> button name
-    std::map<Uint8, std::string> _mousebinds;
-    // controller button -> button name
-    std::map<Uint8, std::string> _ctrlbinds;
-
-    struct PairAxis {
-        std::string neg, pos;
-    };
-    // axis name -> pair of inputs (keys or controllers)
-    std::map<std::string, PairAxis> _pairaxes;
-    // controller axis -> axis name
-    std::map<Uint8, std::string> _ctrlaxes;
+    // value per input axis, indexed by `_axisIds`
+    ActionTable _axisIds;
+    std::vector<Axis> _axes;
+
+    // keycode -> button index
+    std::map<SDL_Keycode, int> _keybinds;
+    // mouse button -> button index
+    std::map<Uint8, int> _mousebinds;
+    // controller button -> button index
+    std::map<Uint8, int> _ctrlbinds;
+    // controller axis -> axis index
+    std::map<Uint8, int> _ctrlaxes;
 
 
     int _backspaces;
     std::string _appendText;
     bool _usingController = false;
     SDL_GameController *_controller = nullptr;
+    InputLog* _log = nullptr;
 
 public:
     // call once per frame
     void update();
-
-    // clear button mappings
+    /// @brief Catches the cursor up with any motion since the last update,
+    /// without taking events from the queue. Call just before rendering, so
+    /// what follows the mouse lags it as little as possible
+    void resample();
+    /// @brief The oldest input since the last call, for the renderer to
+    /// measure input-to-present latency with
+    /// @return an SDL timestamp in ms, or 0 if there's been no input
+    Uint32 takeInputTimestamp();
+
+    /// @brief Brackets a fixed-dt simulation step. Inside one, presses and
+    /// releases are relative to the end of the last step rather than the
+    /// last frame, so a frame with several steps sees each edge once, and
+    /// one with none doesn't lose them
+    void beginStep();
+    void endStep();
+
+    /// @brief Polls events through `log` instead of straight from SDL, so
+    /// they can be recorded or replayed
+    /// @param log owned by the caller; null to go back to SDL
+    void setLog(InputLog* log);
+
+    // clear button and axis mappings
     void resetBindings();
-    void addKeybind(std::string name, SDL_Keycode key);
-    void addMouseBind(std::string name, int mouseButton);
-    void addControllerBind(std::string name, int ctrlButton);
+    void addKeybind(InputAction name, SDL_Keycode key);
+    void addMouseBind(InputAction name, int mouseButton);
+    void addControllerBind(InputAction name, int ctrlButton);
 
+    /// @brief Where the mouse was as of the last update; what gameplay
+    /// should use, so it's the same however often we resample
     Vec2 getMousePos() const;
+    /// @brief Where the mouse is as of the last `resample`; for drawing
+    /// things that follow it, like hover highlights
+    Vec2 getCursorPos() const;
 
-    ButtonState getButtonState(std::string name) const;
+    ButtonState getButtonState(InputAction name) const;
 
     void editText(std::string &text) const;
 
     // returns true iff the Action was pressed this frame
-    bool didPress(std::string name) const;
+    bool didPress(InputAction name) const;
     // returns true when the Action is held down
-    bool isHeld(std::string name) const;
+    bool isHeld(InputAction name) const;
     // returns true iff the Action was released this frame
-    bool didRelease(std::string name) const;
-
-    void addAxisPair(std::string axis, std::string neg, std::string pos);
-    void addControllerAxis(std::string name, Uint8 axis);
-    float getAxis(std::string name) const;
+    bool didRelease(InputAction name) const;
+
+    void addAxisPair(InputAction axis, InputAction neg, InputAction pos);
+    void addControllerAxis(InputAction name, Uint8 axis);
+    float getAxis(InputAction name) const;
+
+private:
+    /// @brief Makes sure the Action has state, and returns its index
+    int addButton(InputAction name);
+    int addAxis(InputAction name);
+    bool replaying() const;
+    void noteInput(Uint32 timestamp);
 };
+
+BENCH(inputQuery, {
+    // the old way: a std::string built per call, traced, then looked up in
+    // a std::map
+    std::map<std::string, ButtonState> byName;
+    const char* names[] = {"quit", "left", "right", "up", "down", "jump",
+        "shoot", "1", "2", "3", "4", "5", "textureReport", "profiler",
+        "click", "rclick"};
+    for (auto name : names) {
+        byName[name] = {};
+    }
+    auto oldGetButtonState = [&](std::string name) {
+        Tracer((std::string("Input::getButtonState-")+name).c_str());
+        auto it = byName.find(name);
+        return it == byName.end() ? ButtonState {} : it->second;
+    };
+
+    Input input;
+    for (int i = 0; i < sizeof(names)/sizeof(names[0]); ++i) {
+        input.addKeybind(names[i], SDLK_a + i);
+    }
+
+    const int iters = 1'000'000;
+    int count = 0;
+    BENCH_LOOP("string map lookup (old)", iters, {
+        count += oldGetButtonState("click").pressed;
+    });
+    BENCH_LOOP("\"click\"_action", iters, {
+        count += input.didPress("click"_action);
+    });
+    // cycle through names, so the hashing can't be hoisted out of the loop
+    const int numNames = sizeof(names)/sizeof(names[0]);
+    BENCH_LOOP("const char*, hashed per call", iters, {
+        count += input.didPress(names[_bench_i % numNames]);
+    });
+    std::vector<std::string> strings(names, names + numNames);
+    BENCH_LOOP("std::string, hashed per call", iters, {
+        count += input.didPress(strings[_bench_i % numNames]);
+    });
+    doNotOptimize(count);
+})
@@ -14,6 +14,7 @@ void quickRemove(std::vector<T> &elems, size_t idx) {
 }
 
 void Particle::update(float dt) {
+    lastPos = pos;
     vel.y += gravity*dt;
     pos += vel*dt;
     age += dt;
@@ -23,9 +24,17 @@ ParticleScene::ParticleScene(Allocator *alloc, Input *input) :
         _input(input), _ui(alloc, input) {
 }
 
+Uint32 ParticleScene::saveState(BinaryWriter &out) const {
+    return writeRecord(out, *this);
+}
+
+void ParticleScene::loadState(const BinaryRecord &record) {
+    readRecord(record, *this);
+}
+
 void ParticleScene::update(float dt) {
     _ui.startUpdate({ 120, 30 });
-    if (_input->didPress("click")) {
+    if (_input->didPress("click"_action)) {
         createParticles();
     }
     _ui.labels((int)_particles.size(), "\n");
@@ -54,7 +63,7 @@ void ParticleScene::render(Renderer *renderer) {
 
     renderer->setColor(1.0, 0.23, 0.05);
     for (auto p : _particles) {
-        renderer->drawRect(p.pos, {p.size});
+        renderer->drawRect(lerp(renderAlpha, p.lastPos, p.pos), {p.size});
     }
 
     _ui.render(renderer);
@@ -67,6 +76,7 @@ void ParticleScene::createParticles() {
         float ang = TAU*i/n;
         Particle p;
         p.pos = pos;
+        p.lastPos = pos;
         p.vel = Vec2 { cos(ang), sin(ang) } * _params.speed * _rng.Normalish(0.5, 2.0);
         p.gravity = _params.gravity;
         p.lifetime = _params.duration;
@@ -2,9 +2,10 @@
 
 #include "color.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "rng.h"
 #include "scene.h"
+#include "serialize.h"
 #include "ui.h"
 #include "vec.h"
 
@@ -12,6 +13,7 @@
 
 struct Particle {
     Vec2 pos;
+    Vec2 lastPos; // position as of the previous update, for interpolation
     Vec2 vel;
     float gravity;
     float lifetime;
@@ -22,6 +24,15 @@ struct Particle {
     void update(float dt);
 };
 
+// what the sliders set, for each new burst
+struct ParticleParams {
+    int numParticles = 512;
+    float duration = 1.5;
+    float speed = 500;
+    float gravity = 0;
+    float size = 7;
+};
+
 class ParticleScene : public Scene {
     UI _ui;
     Input* _input;
@@ -32,22 +43,60 @@ class ParticleScene : public Scene {
     Color bgColor {0x10, 0x20, 0x40};
 
     bool _shouldGenerate = true;
-    struct Params {
-        int numParticles = 512;
-        float duration = 1.5;
-        float speed = 500;
-        float gravity = 0;
-        float size = 7;
-    } _params;
+    ParticleParams _params;
 
     float _emitTimer = 0.0;
 
 public:
     ParticleScene(Allocator *alloc, Input *input); 
 
+    Uint32 saveState(BinaryWriter &out) const override;
+    void loadState(const BinaryRecord &record) override;
+
     void update(float dt) override;
     void render(Renderer *renderer) override;
 
 private:
+    friend struct SerialFields<ParticleScene>;
+
     void createParticles();
 };
+
+// saved field by field rather than whole, so adding, removing or
+// reordering members across a reload can't load one into another
+template <>
+struct SerialFields<Particle> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("pos", &Particle::pos),
+        serialField("lastPos", &Particle::lastPos),
+        serialField("vel", &Particle::vel),
+        serialField("gravity", &Particle::gravity),
+        serialField("lifetime", &Particle::lifetime),
+        serialField("size", &Particle::size),
+        serialField("age", &Particle::age));
+};
+
+template <>
+struct SerialFields<ParticleParams> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("numParticles", &ParticleParams::numParticles),
+        serialField("duration", &ParticleParams::duration),
+        serialField("speed", &ParticleParams::speed),
+        serialField("gravity", &ParticleParams::gravity),
+        serialField("size", &ParticleParams::size));
+};
+
+// what's in flight survives reloads. Rng is saved whole; its engine's
+// layout only changes with the standard library
+template <>
+struct SerialFields<ParticleScene> {
+    // 2: particles and params are records, not raw bytes
+    static constexpr Uint32 version = 2;
+    static constexpr auto fields = std::make_tuple(
+        serialField("particles", &ParticleScene::_particles),
+        serialField("params", &ParticleScene::_params),
+        serialField("emitTimer", &ParticleScene::_emitTimer),
+        serialField("rng", &ParticleScene::_rng));
+};
@@ -0,0 +1,59 @@
+// pixelWriter.h - writes Colors into a 32-bit surface of any channel order
+
+#pragma once
+
+#include "color.h"
+
+#include <SDL2/SDL.h>
+
+/// @brief Packs Colors into whatever channel order a surface has, so pixels
+/// can be generated straight into the renderer's native format (see
+/// `Renderer::createSurface`) and uploaded without a conversion pass.
+/// Only handles 32 bits per pixel
+class PixelWriter {
+    SDL_Surface* _surface;
+    const SDL_PixelFormat* _format;
+    Uint32 _forceBits; // or'd into every pixel
+
+public:
+    /// @param opaque ignore the alpha of written colors, and make every
+    /// pixel fully opaque
+    PixelWriter(SDL_Surface* surface, bool opaque = false)
+            : _surface(surface), _format(surface->format) {
+        assert(_format->BytesPerPixel == 4,
+            "PixelWriter needs 32bpp, got %d", _format->BitsPerPixel);
+        _forceBits = opaque ? _format->Amask : 0;
+    }
+
+    Uint32 pack(Color c) const {
+        Uint32 bits = (Uint32(c.r) << _format->Rshift)
+            | (Uint32(c.g) << _format->Gshift)
+            | (Uint32(c.b) << _format->Bshift);
+        if (_forceBits) {
+            return bits | _forceBits;
+        }
+        // formats without alpha have no bits to put it in
+        if (_format->Amask) {
+            bits |= Uint32(c.a) << _format->Ashift;
+        }
+        return bits;
+    }
+
+    Uint32* row(int y) const {
+        return (Uint32*)((Uint8*)_surface->pixels + y*_surface->pitch);
+    }
+
+    void set(int x, int y, Color c) {
+        row(y)[x] = pack(c);
+    }
+
+    void fill(Color c) {
+        Uint32 packed = pack(c);
+        for (int y = 0; y < _surface->h; ++y) {
+            Uint32* r = row(y);
+            for (int x = 0; x < _surface->w; ++x) {
+                r[x] = packed;
+            }
+        }
+    }
+};
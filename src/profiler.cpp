@@ -0,0 +1,236 @@
+#include "profiler.h"
+
+#include <new>
+#include <string.h>
+
+Profiler* gProfiler = nullptr;
+std::atomic<int> gNumAllocs {0};
+
+// count everything the game allocates, containers included. The kernel
+// hands out the same malloc, so memory can safely cross a reload either way
+void* operator new(size_t size) {
+    gNumAllocs++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+ProfileScope::~ProfileScope() {
+    if (gProfiler) {
+        gProfiler->addScope(_name, SDL_GetPerformanceCounter() - _start);
+    }
+}
+
+void Profiler::unload() {
+    _scopes.clear();
+    _scenes.clear();
+    _ui.unload();
+}
+
+void Profiler::toggle() {
+    _visible = !_visible;
+}
+bool Profiler::visible() const {
+    return _visible;
+}
+
+void Profiler::addScope(const char* name, Uint64 ticks) {
+    for (auto &scope : _scopes) {
+        // the same literal can have different addresses in different files
+        if (scope.name == name || strcmp(scope.name, name) == 0) {
+            scope.ticks += ticks;
+            scope.calls++;
+            return;
+        }
+    }
+    _scopes.push_back({name, ticks, 1, 0, 0});
+}
+
+void Profiler::addSceneTime(const char* scene, ProfilePhase phase, Uint64 ticks) {
+    _phaseTicks[phase] += ticks;
+    for (auto &stats : _scenes) {
+        if (stats.name == scene) {
+            stats.ticks[phase] += ticks;
+            return;
+        }
+    }
+    SceneStats stats {scene, {}, {}};
+    stats.ticks[phase] = ticks;
+    _scenes.push_back(stats);
+}
+
+void Profiler::render(Renderer* renderer) {
+    if (!_visible) {
+        return;
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    const Vec2 pos {screenSize.x - 440, 30};
+    const Vec2 graphSize {historyLen * 3.0f, 100};
+
+    _ui.setLayer(layerOverlay);
+    _ui.startUpdate(pos + Vec2{0, graphSize.y + 10});
+    int lines = 0;
+    float frameMs = avgFrameMs();
+    float worstMs = 0;
+    for (auto &sample : _history) {
+        worstMs = max(worstMs, sample.totalMs);
+    }
+    _ui.labels("frame: ", frameMs, "ms");
+    _ui.align(200);
+    _ui.labels("worst: ", worstMs, "ms");
+    _ui.line(); lines++;
+    _ui.labels("draws: ", _renderStats.drawCalls);
+    _ui.align(140);
+    _ui.labels("uploads: ", _renderStats.textureUploads);
+    _ui.align(290);
+    _ui.labels("allocs: ", _frameAllocs);
+    _ui.line(); lines++;
+
+    _ui.label("scene");
+    _ui.align(200);
+    _ui.label("update");
+    _ui.align(300);
+    _ui.label("render");
+    _ui.line(); lines++;
+    for (auto &scene : _scenes) {
+        _ui.label(scene.name);
+        _ui.align(200);
+        _ui.label(scene.ms[phaseUpdate]);
+        _ui.align(300);
+        _ui.label(scene.ms[phaseRender]);
+        _ui.line(); lines++;
+    }
+
+    // a handful of the slowest, without sorting them all
+    const int numSlowest = 5;
+    int slowest[numSlowest];
+    int numFound = 0;
+    for (int i = 0; i < _scopes.size(); ++i) {
+        float ms = _scopes[i].ms;
+        if (numFound == numSlowest && ms <= _scopes[slowest[numSlowest-1]].ms) {
+            continue;
+        }
+        // the fastest of them drops off the end if there's no room
+        int j = numFound < numSlowest ? numFound++ : numSlowest-1;
+        for (; j > 0 && _scopes[slowest[j-1]].ms < ms; --j) {
+            slowest[j] = slowest[j-1];
+        }
+        slowest[j] = i;
+    }
+    _ui.label("slowest scopes");
+    _ui.align(300);
+    _ui.label("calls");
+    _ui.line(); lines++;
+    for (int i = 0; i < numFound; ++i) {
+        auto &scope = _scopes[slowest[i]];
+        _ui.label(scope.name);
+        _ui.align(200);
+        _ui.label(scope.ms);
+        _ui.align(300);
+        _ui.label(scope.lastCalls);
+        _ui.line(); lines++;
+    }
+    _ui.labels("overlay: ", _overlayMs, "ms");
+    _ui.align(200);
+    _ui.labels(frameMs > 0 ? 100 * _overlayMs / frameMs : 0.0f, "% of frame");
+    _ui.line(); lines++;
+
+    int prevLayer = renderer->setLayer(layerOverlay);
+    // the backdrop goes first, so everything else draws over it
+    float lineHeight = Renderer::fontSize.y + 10;
+    renderer->setColor(0, 0, 0, 0.75);
+    renderer->drawRect(pos - Vec2{10},
+        Vec2{graphSize.x + 20, graphSize.y + 20 + lines*lineHeight});
+    renderGraph(renderer, pos);
+    renderer->setLayer(prevLayer);
+    _ui.render(renderer);
+
+    _overlayMs = lerp(smoothing, _overlayMs,
+        toMs(SDL_GetPerformanceCounter() - start));
+}
+
+void Profiler::renderGraph(Renderer* renderer, Vec2 pos) {
+    const float barWidth = 3;
+    const float height = 100;
+    const float maxMs = 50; // the top of the graph
+    const float pxPerMs = height / maxMs;
+    const Vec2 bottom = pos + Vec2{0, height};
+    // oldest on the left
+    for (int i = 0; i < historyLen; ++i) {
+        auto &sample = _history[(_historyPos + i) % historyLen];
+        float x = bottom.x + i*barWidth;
+        float y = bottom.y;
+        float updateH = min(sample.phaseMs[phaseUpdate] * pxPerMs, height);
+        float renderH = min(sample.phaseMs[phaseRender] * pxPerMs, height - updateH);
+        float restH = clamp(sample.totalMs * pxPerMs - updateH - renderH,
+            0.0f, height - updateH - renderH);
+        renderer->setColor(0.3, 0.5, 1.0);
+        renderer->drawRect(x, y - updateH, barWidth, updateH);
+        y -= updateH;
+        renderer->setColor(0.3, 0.9, 0.4);
+        renderer->drawRect(x, y - renderH, barWidth, renderH);
+        y -= renderH;
+        renderer->setColor(0.5, 0.5, 0.5);
+        renderer->drawRect(x, y - restH, barWidth, restH);
+    }
+    // 60 and 30 fps
+    renderer->setColor(1, 1, 0);
+    for (float ms : {1000/60.0f, 1000/30.0f}) {
+        float y = bottom.y - ms * pxPerMs;
+        renderer->drawLine({pos.x, y}, {pos.x + historyLen*barWidth, y});
+    }
+}
+
+void Profiler::endFrame(Renderer::Stats stats) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    FrameSample &sample = _history[_historyPos];
+    sample.totalMs = _lastFrameEnd ? toMs(now - _lastFrameEnd) : 0;
+    for (int p = 0; p < numPhases; ++p) {
+        sample.phaseMs[p] = toMs(_phaseTicks[p]);
+        _phaseTicks[p] = 0;
+    }
+    _historyPos = (_historyPos + 1) % historyLen;
+    _lastFrameEnd = now;
+
+    for (auto &scope : _scopes) {
+        scope.ms = lerp(smoothing, scope.ms, toMs(scope.ticks));
+        scope.lastCalls = scope.calls;
+        scope.ticks = 0;
+        scope.calls = 0;
+    }
+    for (auto &scene : _scenes) {
+        for (int p = 0; p < numPhases; ++p) {
+            scene.ms[p] = lerp(smoothing, scene.ms[p], toMs(scene.ticks[p]));
+            scene.ticks[p] = 0;
+        }
+    }
+
+    _renderStats = stats;
+    int allocs = gNumAllocs;
+    _frameAllocs = allocs - _allocsAtFrameStart;
+    _allocsAtFrameStart = allocs;
+}
+
+float Profiler::toMs(Uint64 ticks) const {
+    return 1000.0 * ticks / _freq;
+}
+
+float Profiler::avgFrameMs() const {
+    float total = 0;
+    int count = 0;
+    for (auto &sample : _history) {
+        if (sample.totalMs > 0) {
+            total += sample.totalMs;
+            count++;
+        }
+    }
+    return count > 0 ? total / count : 0;
+}
@@ -0,0 +1,112 @@
+// profiler.h - frame and scope timing, with an overlay to show it
+
+#pragma once
+
+#include "common.h"
+#include "input_sdl.h"
+#include "render.h"
+#include "ui.h"
+
+#include <atomic>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+class Profiler;
+/// @brief The profiler scopes report to; set by whoever owns it, and null
+/// when there isn't one
+extern Profiler* gProfiler;
+/// @brief Heap allocations made through operator new in this module so far
+extern std::atomic<int> gNumAllocs;
+
+/// @brief Times from construction to destruction, and adds it to the
+/// profiler's total for `name` this frame. Scopes with the same name add up
+/// @param name must outlive the frame, i.e. be a string literal
+class ProfileScope {
+    const char* _name;
+    Uint64 _start;
+public:
+    ProfileScope(const char* name)
+        : _name(name), _start(SDL_GetPerformanceCounter()) {}
+    ~ProfileScope();
+};
+
+enum ProfilePhase {
+    phaseUpdate,
+    phaseRender,
+    numPhases,
+};
+
+/// @brief Collects timings every frame, and draws them over the scene when
+/// visible: a graph of recent frame times split into update and render,
+/// per-scene update and render times, renderer and allocation counters, and
+/// the slowest scopes.
+///
+/// Lives in Program, so it persists across reloads. Names it's given point
+/// into game.dll though, so `unload` has to forget them before a reload
+class Profiler {
+    UI _ui;
+    bool _visible = false;
+    Uint64 _freq = SDL_GetPerformanceFrequency();
+
+    struct ScopeStats {
+        const char* name;
+        Uint64 ticks; // this frame, so far
+        int calls;
+        float ms; // smoothed over recent frames
+        int lastCalls;
+    };
+    std::vector<ScopeStats> _scopes;
+
+    struct SceneStats {
+        const char* name;
+        Uint64 ticks[numPhases];
+        float ms[numPhases]; // smoothed
+    };
+    std::vector<SceneStats> _scenes;
+
+    struct FrameSample {
+        float totalMs; // start to start, including any time spent waiting
+        float phaseMs[numPhases];
+    };
+    static const int historyLen = 120;
+    FrameSample _history[historyLen] = {};
+    int _historyPos = 0; // where the next sample goes
+    Uint64 _phaseTicks[numPhases] = {};
+    Uint64 _lastFrameEnd = 0;
+
+    Renderer::Stats _renderStats {};
+    int _allocsAtFrameStart = 0;
+    int _frameAllocs = 0;
+    float _overlayMs = 0; // what drawing the overlay costs, smoothed
+
+    // how much of each new frame goes into a smoothed average
+    static constexpr float smoothing = 0.1f;
+
+public:
+    Profiler(Allocator* allocator, Input* input) : _ui(allocator, input) {}
+
+    /// @brief Forgets every name it's been given; call before game.dll
+    /// unloads, since they point into it
+    void unload();
+
+    void toggle();
+    bool visible() const;
+
+    /// @brief Adds to a scope's total for this frame; see ProfileScope
+    void addScope(const char* name, Uint64 ticks);
+    /// @brief Adds time a scene spent updating or rendering this frame
+    void addSceneTime(const char* scene, ProfilePhase phase, Uint64 ticks);
+
+    /// @brief Draws the overlay if it's visible. Call once per frame, before
+    /// `Renderer::endFrame`
+    void render(Renderer* renderer);
+    /// @brief Closes out the frame's timings. Call once per frame, after
+    /// `Renderer::endFrame`
+    void endFrame(Renderer::Stats stats);
+
+private:
+    float toMs(Uint64 ticks) const;
+    float avgFrameMs() const;
+    void renderGraph(Renderer* renderer, Vec2 pos);
+};
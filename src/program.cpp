@@ -1,7 +1,11 @@
 #include "common.h"
+#include "fileWatcher.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "profiler.h"
+#include "reloadState.h"
+#include "render.h"
 #include "scene.h"
+#include "serialize.h"
 #include "ui.h"
 #include "vec.h"
 
@@ -21,13 +25,15 @@
 
 struct Program {
     Allocator* _allocator;
-    SDL_Window* _window;
-    Renderer* _renderer;
+    Renderer* _renderer; // owned by the kernel
+    ReloadState* _reloadState; // owned by the kernel
+    FileWatcher* _fileWatcher; // owned by the kernel
     Input _input;
     float t = 0.0;
     bool _quit = false;
 
     UI _menu;
+    Profiler _profiler;
     TexGen _texGen;
 
     struct SceneDesc {
@@ -38,39 +44,27 @@ struct Program {
     // stored as an index for ease of serializing state
     int _curScene = 0;
 
-    Program(Allocator* allocator) :
-            _allocator(allocator),
-            _menu(allocator, &_input) {
-        _window = SDL_CreateWindow(
-            "I Heard You Liked Video Games",
-            SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-            screenSize.x, screenSize.y,
-            SDL_WINDOW_SHOWN);
-        assert_SDL(_window, "window creation failed");
-
-        SDL_Surface* screen = SDL_GetWindowSurface(_window);
-        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0xff, 0xff, 0xff));
-        SDL_UpdateWindowSurface(_window);
-
-        SDL_Renderer* sdlRenderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED);
-        assert_SDL(sdlRenderer, "renderer creation failed");
-        /// HACK: we should probably allocate _renderer directly as a struct member
-        /// we heap-allocate it because it's easier than dealing with constructor shenanigans
-        _renderer = (Renderer*)_allocator->calloc(1, sizeof(Renderer));
-        new (_renderer) Renderer(sdlRenderer);
-    }
-
-    ~Program() {
-        SDL_DestroyRenderer(_renderer->sdl());
-        SDL_DestroyWindow(_window);
+    // bump if the snapshot's layout changes; each scene's record is
+    // versioned by its own SerialFields
+    static const Uint32 reloadStateVersion = 1;
 
-        _allocator->free(_renderer);
+    Program(Allocator* allocator, Renderer* renderer, InputLog* inputLog,
+            ReloadState* reloadState, FileWatcher* fileWatcher) :
+            _allocator(allocator),
+            _renderer(renderer),
+            _reloadState(reloadState),
+            _fileWatcher(fileWatcher),
+            _menu(allocator, &_input),
+            _profiler(allocator, &_input) {
+        _input.setLog(inputLog);
     }
 
     /// @brief Called after loading the dll, and on each reload.
     /// Useful for iterating configs at the moment
     void onLoad() {
-        auto tex = _allocator->knew<TexGenScene>(&_texGen, _allocator, &_input);
+        gProfiler = &_profiler;
+        auto tex = _allocator->knew<TexGenScene>(&_texGen, _allocator, &_input,
+            _fileWatcher);
         _scenes.push_back({"texgen", tex});
         _scenes.push_back({"eyegen",
             _allocator->knew<EyeGenScene>(_allocator, &_input)});
@@ -82,6 +76,7 @@ struct Program {
             _allocator->knew<ParticleScene>(_allocator, &_input)});
         _scenes.push_back({"audio",
             _allocator->knew<AudioScene>(_allocator, &_input)});
+        bool restored = loadState();
         for (auto desc : _scenes) {
             desc.scene->onLoad();
         }
@@ -113,16 +108,22 @@ struct Program {
         _input.addKeybind("3", SDLK_3);
         _input.addKeybind("4", SDLK_4);
         _input.addKeybind("5", SDLK_5);
+        _input.addKeybind("textureReport", SDLK_F1);
+        _input.addKeybind("profiler", SDLK_F3);
 
         _input.addMouseBind("click", SDL_BUTTON_LEFT);
         _input.addMouseBind("rclick", SDL_BUTTON_RIGHT);
 
-        _texGen.generateTextures(_renderer);
+        // on a reload, the textures from before are still good
+        if (!restored) {
+            _texGen.generateTextures(_renderer);
+        }
     }
 
     /// @brief Called before unloading the dll. Clear any state that can't be
     /// persisted across reloads.
     void onUnload() {
+        saveState();
         // unload in reverse of load order, in case of interscene dependencies,
         // which we probably shouldn't encourage, but this seems saner than not
         for (int i = _scenes.size()-1; i >= 0; i--) {
@@ -131,6 +132,52 @@ struct Program {
             _allocator->del(scene);
         }
         _scenes.clear();
+        _profiler.unload();
+        gProfiler = nullptr;
+    }
+
+    /// @brief Snapshots every scene's state into the kernel's ReloadState,
+    /// as a binary file with a record per scene, by name
+    void saveState() {
+        BinaryWriter out(reloadStateVersion);
+        std::vector<BinaryField> scenes;
+        for (auto desc : _scenes) {
+            Uint32 record = desc.scene->saveState(out);
+            if (record) {
+                // the size only has to cover the header; nested records get
+                // checked as they're read
+                scenes.push_back({fieldId(desc.name), binaryRecord, record,
+                    sizeof(BinaryRecordHeader), 1, 0});
+            }
+        }
+        Uint32 root = out.startRecord(scenes.size(), reloadStateVersion);
+        for (int i = 0; i < scenes.size(); ++i) {
+            out.setField(root, i, scenes[i]);
+        }
+        out.setRoot(root);
+        _reloadState->store(out.data().data(), out.data().size());
+    }
+
+    /// @brief Hands each scene back what it saved before the reload
+    /// @return false if there was nothing saved, i.e. this is the first load
+    bool loadState() {
+        if (_reloadState->empty()) {
+            return false;
+        }
+        BinaryFile state;
+        bool valid = check(
+            state.open(_reloadState->data(), _reloadState->size()),
+            "saved scene state is corrupt; starting fresh");
+        BinaryRecord root = state.root();
+        for (int i = 0; valid && i < _scenes.size(); ++i) {
+            auto field = root.find(fieldId(_scenes[i].name), i);
+            if (field) {
+                _scenes[i].scene->loadState(root.record(*field));
+            }
+        }
+        log("restored %d bytes of scene state", (int)_reloadState->size());
+        _reloadState->clear();
+        return valid;
     }
 
     bool shouldQuit() {
@@ -141,19 +188,28 @@ struct Program {
         return _scenes[_curScene].scene;
     }
 
-    void update(float dt) {
+    /// @brief Once per frame, before any of its updates: polls input, and
+    /// handles what isn't part of the simulation, like the scene menu
+    void startFrame() {
         int stackval = 0;
-        Tracer trace("Game::update");
+        Tracer trace("Game::startFrame");
         trace("stack addr: %x (val=%d)", &stackval, stackval);
+        ProfileScope profile("Program::startFrame");
 
         _input.update();
 
         trace("input handling");
-        if (_input.didPress("quit")) {
+        if (_input.didPress("quit"_action)) {
             trace("quitting");
             _quit = true;
             return;
         }
+        if (_input.didPress("textureReport"_action)) {
+            _renderer->textures().logReport();
+        }
+        if (_input.didPress("profiler"_action)) {
+            _profiler.toggle();
+        }
 
         // change current scene
         _menu.startUpdate({30, 30});
@@ -163,19 +219,38 @@ struct Program {
                 _curScene = i;
             }
         }
+    }
 
-        // update current scene
+    /// @brief Once per fixed-dt step; zero or more times a frame
+    void update(float dt) {
+        ProfileScope profile("Program::update");
+        Uint64 start = SDL_GetPerformanceCounter();
+        _input.beginStep();
         scene()->update(dt);
+        _input.endStep();
+        _profiler.addSceneTime(_scenes[_curScene].name, phaseUpdate,
+            SDL_GetPerformanceCounter() - start);
     }
 
-    void render() {
+    /// @param alpha how far we are between the last update and the next one,
+    /// used to interpolate anything that moves
+    void render(float alpha) {
         Tracer trace("Game::render");
+        // pick up mouse motion that came in while this frame's updates ran
+        _input.resample();
         _renderer->startFrame();
 
+        Uint64 start = SDL_GetPerformanceCounter();
+        scene()->renderAlpha = alpha;
         scene()->render(_renderer);
+        _profiler.addSceneTime(_scenes[_curScene].name, phaseRender,
+            SDL_GetPerformanceCounter() - start);
         _menu.render(_renderer);
+        _profiler.render(_renderer);
 
+        _renderer->setInputTimestamp(_input.takeInputTimestamp());
         _renderer->endFrame();
+        _profiler.endFrame(_renderer->stats());
 
         // only trace for one frame per reload to minimize spam
         trace("end"); // we're about to disable tracing so, make it match lol
@@ -186,8 +261,11 @@ struct Program {
 extern "C" {
 
 __declspec(dllexport)
-Program* newGame(Allocator* allocator) {
-    return allocator->knew<Program>(allocator);
+Program* newGame(Allocator* allocator, Renderer* renderer,
+        InputLog* inputLog, ReloadState* reloadState,
+        FileWatcher* fileWatcher) {
+    return allocator->knew<Program>(allocator, renderer, inputLog,
+        reloadState, fileWatcher);
 }
 __declspec(dllexport)
 void freeGame(Program* game, Allocator* allocator) {
@@ -210,6 +288,11 @@ bool shouldQuit(Program* game) {
     return game->shouldQuit();
 }
 
+__declspec(dllexport)
+void startFrame(Program* game) {
+    game->startFrame();
+}
+
 __declspec(dllexport)
 void update(Program* game, float dt) {
     game->t += dt;
@@ -217,8 +300,8 @@ void update(Program* game, float dt) {
 }
 
 __declspec(dllexport)
-const void renderScene(Program* game) {
-    game->render();
+const void renderScene(Program* game, float alpha) {
+    game->render(alpha);
 }
 
 } // extern "C"
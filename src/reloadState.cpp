@@ -0,0 +1,37 @@
+#include "reloadState.h"
+
+#include <string.h>
+
+ReloadState::ReloadState(Allocator* allocator) : _allocator(allocator) {
+}
+
+ReloadState::~ReloadState() {
+    _allocator->free(_data);
+}
+
+void ReloadState::store(const void* data, size_t size) {
+    if (size > _capacity) {
+        // nothing worth keeping; a snapshot replaces the whole thing
+        _allocator->free(_data);
+        _data = (Uint8*)_allocator->malloc(size);
+        _capacity = size;
+    }
+    memcpy(_data, data, size);
+    _size = size;
+}
+
+void ReloadState::clear() {
+    _size = 0;
+}
+
+const Uint8* ReloadState::data() const {
+    return _data;
+}
+
+size_t ReloadState::size() const {
+    return _size;
+}
+
+bool ReloadState::empty() const {
+    return _size == 0;
+}
@@ -0,0 +1,32 @@
+// reloadState.h - memory the kernel keeps for game.dll across reloads
+
+#pragma once
+
+#include "common.h"
+
+/// @brief Where game.dll snapshots its state before it's unloaded, to
+/// restore once it's reloaded, rather than rebuilding it from scratch.
+///
+/// Owned by the kernel, and grown through the kernel's Allocator rather than
+/// whichever dll's operator new, so the memory doesn't depend on the code
+/// being swapped out. Holds bytes, not objects: what goes in is a
+/// BinaryWriter's output, so nothing in it points into the old dll
+class ReloadState {
+    Allocator* _allocator;
+    Uint8* _data = nullptr;
+    size_t _size = 0;
+    size_t _capacity = 0;
+
+public:
+    ReloadState(Allocator* allocator);
+    ~ReloadState();
+
+    /// @brief Replaces what's stored with a copy of `size` bytes
+    void store(const void* data, size_t size);
+    /// @brief Forgets what's stored, keeping the memory for next time
+    void clear();
+
+    const Uint8* data() const;
+    size_t size() const;
+    bool empty() const;
+};
@@ -0,0 +1,768 @@
+#include "render.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static_assert(sizeof(Vertex) == sizeof(SDL_Vertex), "Vertex must match SDL_Vertex");
+
+const Vec2 Renderer::fontSize = FONT_SIZE;
+
+void Renderer::loadFont() {
+    _font = _textures.load(FONT_FILE, "font");
+    _alphabetTexture = _textures.get(_font).texture;
+    assert(_alphabetTexture, "%s failed to load", FONT_FILE);
+}
+void Renderer::unloadFont() {
+    _textures.release(_font);
+    _alphabetTexture = nullptr;
+    _textures.freeAll();
+}
+
+Renderer::Renderer() {
+    _pendingLock = SDL_CreateMutex();
+}
+
+Renderer::~Renderer() {
+    // backends should've stopped it already, since it calls into them
+    check(!_thread, "render thread still running at shutdown");
+    SDL_DestroyMutex(_pendingLock);
+}
+
+TextureManager& Renderer::textures() {
+    return _textures;
+}
+
+SDL_Surface* Renderer::createSurface(int w, int h) const {
+    return SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, pixelFormat());
+}
+
+Texture* Renderer::createTexture(SDL_Surface* surface) {
+    Texture* texture = allocTexture(surface->w, surface->h);
+    queueUpload(texture, surface, false, {0, 0});
+    return texture;
+}
+void Renderer::updateTexture(Texture* texture, SDL_Surface* surface, Vec2i pos) {
+    SDL_LockMutex(_pendingLock);
+    // same quads, different pixels; the frame diff can't see that, so
+    // anything drawn from this part of the texture gets redrawn
+    Vec2 size = Vec2i{surface->w, surface->h}.to<float>();
+    _dirtyTexels.push_back({texture, {pos.to<float>(), size}});
+    SDL_UnlockMutex(_pendingLock);
+    queueUpload(texture, surface, true, pos);
+}
+void Renderer::queueUpload(Texture* texture, SDL_Surface* surface,
+        bool partial, Vec2i pos) {
+    TextureOp op {texture, surface, _frame, partial, pos};
+    _numUploads++;
+    if (!_thread) {
+        upload(op);
+        return;
+    }
+    // the caller owns the surface, so the render thread gets a copy
+    op.surface = SDL_ConvertSurface(surface, surface->format, 0);
+    SDL_LockMutex(_pendingLock);
+    _textureOps.push_back(op);
+    SDL_UnlockMutex(_pendingLock);
+}
+void Renderer::upload(TextureOp& op) {
+    if (op.partial) {
+        uploadTextureRegion(op.texture, op.surface, op.pos);
+    } else {
+        uploadTexture(op.texture, op.surface);
+    }
+}
+void Renderer::destroyTexture(Texture* texture) {
+    if (!texture) {
+        return;
+    }
+    SDL_LockMutex(_pendingLock);
+    // a new texture could reuse this address, and draw differently with
+    // otherwise identical quads, which the frame diff wouldn't notice
+    _fullRedraw = true;
+    if (_thread) {
+        // frames already handed off may still draw with it
+        _textureOps.push_back({texture, nullptr, _frame, false, {0, 0}});
+    }
+    SDL_UnlockMutex(_pendingLock);
+    if (!_thread) {
+        freeTexture(texture);
+    }
+}
+
+Texture* Renderer::loadTexture(const char* filename) {
+    SDL_Surface *surf = IMG_Load(filename);
+    if (!surf) {
+        return nullptr;
+    }
+    Texture* texture = createTexture(surf);
+    SDL_FreeSurface(surf);
+    return texture;
+}
+
+void Renderer::startFrame() {
+    _rec->commands.clear();
+    _rec->vertices.clear();
+    _numDraws = 0;
+    _stats.textCacheHits = 0;
+    _stats.textCacheMisses = 0;
+    _layer = layerWorld;
+    _frame++;
+    if (_frame % textCacheFrames == 0) {
+        trimTextCache();
+    }
+    _textures.startFrame();
+}
+void Renderer::endFrame() {
+    _rec->frame = _frame;
+    _rec->bgColor = _bgColor;
+    _stats.commands = _numDraws;
+    _numDraws = 0;
+    _stats.textureUploads = _numUploads;
+    _numUploads = 0;
+    if (_inputTimestamp) {
+        _pendingInput.push_back({_frame, _inputTimestamp});
+        _inputTimestamp = 0;
+    }
+    if (!_thread) {
+        drawFrame(*_rec);
+        resolveInputLatency();
+        return;
+    }
+    // publish, and take back whichever slot was there before; that's either
+    // a frame the render thread already drew, or one it never got to
+    int prev = _readyIdx.exchange(_recIdx | frameFresh);
+    _recIdx = prev & ~frameFresh;
+    _rec = &_frames[_recIdx];
+    SDL_SemPost(_framePosted);
+    resolveInputLatency();
+}
+
+void Renderer::setInputTimestamp(Uint32 timestamp) {
+    if (timestamp && (!_inputTimestamp || timestamp < _inputTimestamp)) {
+        _inputTimestamp = timestamp;
+    }
+}
+
+void Renderer::resolveInputLatency() {
+    Uint64 presented = _presented.load();
+    Uint32 frame = presented >> 32;
+    Uint32 presentedAt = Uint32(presented);
+    int resolved = 0;
+    for (auto &input : _pendingInput) {
+        if (input.frame > frame) {
+            break;
+        }
+        // timestamps are only ms, so an event can look newer than the
+        // present that showed it
+        int ms = max(0, int(presentedAt - input.timestamp));
+        _latencyHist[min(ms, numLatencyBuckets-1)]++;
+        _numLatencies++;
+        resolved++;
+    }
+    _pendingInput.erase(_pendingInput.begin(), _pendingInput.begin() + resolved);
+}
+
+float Renderer::inputLatencyMs(float pct) const {
+    int target = ceil(pct * _numLatencies);
+    int seen = 0;
+    for (int i = 0; i < numLatencyBuckets; ++i) {
+        seen += _latencyHist[i];
+        if (seen >= target) {
+            return i;
+        }
+    }
+    return numLatencyBuckets-1;
+}
+
+void Renderer::logLatencyReport() {
+    resolveInputLatency();
+    if (_numLatencies == 0) {
+        return;
+    }
+    log("input-to-present latency: %d frames with input", _numLatencies);
+    log("  p50 %.0fms  p90 %.0fms  p99 %.0fms  worst %.0fms%s",
+        inputLatencyMs(0.5), inputLatencyMs(0.9), inputLatencyMs(0.99),
+        inputLatencyMs(1),
+        _latencyHist[numLatencyBuckets-1] ? "+" : "");
+}
+
+bool Renderer::startRenderThread() {
+    if (_thread) {
+        return true;
+    }
+    _stopThread = false;
+    _framePosted = SDL_CreateSemaphore(0);
+    _threadReady = SDL_CreateSemaphore(0);
+    _thread = SDL_CreateThread(renderThread, "render", this);
+    if (!_thread) {
+        log("couldn't start render thread, drawing inline: %s", SDL_GetError());
+    } else {
+        SDL_SemWait(_threadReady);
+        if (!_threadAttached) {
+            log("backend couldn't attach to the render thread, drawing inline");
+            SDL_WaitThread(_thread, nullptr);
+            _thread = nullptr;
+        }
+    }
+    SDL_DestroySemaphore(_threadReady);
+    _threadReady = nullptr;
+    if (!_thread) {
+        SDL_DestroySemaphore(_framePosted);
+        _framePosted = nullptr;
+    }
+    return _thread != nullptr;
+}
+
+void Renderer::stopRenderThread() {
+    if (!_thread) {
+        return;
+    }
+    _stopThread = true;
+    SDL_SemPost(_framePosted);
+    SDL_WaitThread(_thread, nullptr);
+    _thread = nullptr;
+    SDL_DestroySemaphore(_framePosted);
+    _framePosted = nullptr;
+}
+
+void Renderer::finishTextureOps() {
+    // nothing's in flight anymore, so finish off anything still queued
+    SDL_LockMutex(_pendingLock);
+    _drawOps.swap(_textureOps);
+    SDL_UnlockMutex(_pendingLock);
+    for (auto &op : _drawOps) {
+        if (op.surface) {
+            upload(op);
+            SDL_FreeSurface(op.surface);
+        } else {
+            freeTexture(op.texture);
+        }
+    }
+    _drawOps.clear();
+}
+
+int Renderer::renderThread(void* data) {
+    auto renderer = (Renderer*)data;
+    renderer->_threadAttached = renderer->attachThread();
+    SDL_SemPost(renderer->_threadReady);
+    if (!renderer->_threadAttached) {
+        return 0;
+    }
+    while (true) {
+        SDL_SemWait(renderer->_framePosted);
+        if (renderer->_stopThread) {
+            // the main thread's waiting on us, so this is the last chance to
+            // touch the backend from here
+            renderer->finishTextureOps();
+            renderer->detachThread();
+            return 0;
+        }
+        // several posts can pile up while we draw; only the first one to
+        // come in after a new frame finds anything to do
+        if (!(renderer->_readyIdx.load() & frameFresh)) {
+            continue;
+        }
+        int prev = renderer->_readyIdx.exchange(renderer->_drawIdx);
+        renderer->_drawIdx = prev & ~frameFresh;
+        renderer->drawFrame(renderer->_frames[renderer->_drawIdx]);
+    }
+}
+
+void Renderer::drawFrame(FrameData& frame) {
+    SDL_LockMutex(_pendingLock);
+    _drawOps.swap(_textureOps);
+    for (Rect rect : _invalidRects) {
+        _damage.add(rect);
+    }
+    _invalidRects.clear();
+    _drawDirtyTexels.swap(_dirtyTexels);
+    _dirtyTexels.clear();
+    bool fullRedraw = _fullRedraw;
+    _fullRedraw = false;
+    SDL_UnlockMutex(_pendingLock);
+
+    // uploads can happen early, but a texture can't be freed until every
+    // frame recorded before it was destroyed has been drawn
+    for (auto &op : _drawOps) {
+        if (op.surface) {
+            upload(op);
+            SDL_FreeSurface(op.surface);
+            op.surface = nullptr;
+            op.texture = nullptr;
+        }
+    }
+    flush(frame, fullRedraw);
+    present();
+    _presented = (Uint64(frame.frame) << 32) | SDL_GetTicks();
+    int kept = 0;
+    for (auto &op : _drawOps) {
+        if (!op.texture) {
+            continue;
+        } else if (op.frame <= frame.frame) {
+            freeTexture(op.texture);
+        } else {
+            _drawOps[kept++] = op;
+        }
+    }
+    _drawOps.resize(kept);
+
+    SDL_LockMutex(_pendingLock);
+    // anything not freed yet goes back in line, ahead of newer requests
+    _textureOps.insert(_textureOps.begin(), _drawOps.begin(), _drawOps.end());
+    _drawStats = _flushStats;
+    SDL_UnlockMutex(_pendingLock);
+    _drawOps.clear();
+}
+
+Renderer::Stats Renderer::stats() const {
+    Stats stats = _stats;
+    SDL_LockMutex(_pendingLock);
+    stats.drawCalls = _drawStats.drawCalls;
+    stats.damageRects = _drawStats.damageRects;
+    stats.redrawnPixels = _drawStats.redrawnPixels;
+    SDL_UnlockMutex(_pendingLock);
+    return stats;
+}
+
+void Renderer::background(Color c) {
+    _bgColor = c;
+}
+
+int Renderer::setLayer(int layer) {
+    int prev = _layer;
+    _layer = layer;
+    return prev;
+}
+
+void Renderer::setColor(float r, float g, float b, float a) {
+    _color = rgbColor(r, g, b, a);
+}
+void Renderer::setColor(Color c) {
+    // color goes on each vertex, so changing it doesn't cost anything
+    _color = c;
+}
+void Renderer::drawRect(float x, float y, float w, float h) {
+    int v = pushQuads(nullptr, 1);
+    writeRect(v, {{x, y}, {w, h}}, {}, _color);
+}
+void Renderer::drawRect(Vec2 pos, Vec2 size) {
+    drawRect(pos.x, pos.y, size.x, size.y);
+}
+void Renderer::drawRect(Rect rect) {
+    drawRect(rect.pos.x, rect.pos.y, rect.size.x, rect.size.y);
+}
+void Renderer::drawBox(float x, float y, float w, float h) {
+    // one pixel wide along each edge
+    int v = pushQuads(nullptr, 4);
+    writeRect(v+0,  {{x, y}, {w, 1}}, {}, _color);
+    writeRect(v+4,  {{x, y+h-1}, {w, 1}}, {}, _color);
+    writeRect(v+8,  {{x, y+1}, {1, max(h-2, 0.0f)}}, {}, _color);
+    writeRect(v+12, {{x+w-1, y+1}, {1, max(h-2, 0.0f)}}, {}, _color);
+}
+void Renderer::drawBox(Vec2 pos, Vec2 size) {
+    drawBox(pos.x, pos.y, size.x, size.y);
+}
+void Renderer::drawBox(Rect rect) {
+    drawBox(rect.pos.x, rect.pos.y, rect.size.x, rect.size.y);
+}
+
+void Renderer::drawLine(Vec2 a, Vec2 b) {
+    // a one pixel wide quad running from a to b
+    Vec2 dir = (b-a).normalized();
+    if (dir == Vec2{0}) {
+        return;
+    }
+    Vec2 n = Vec2{-dir.y, dir.x} * 0.5f;
+    Vec2 corners[4] { a+n, b+n, b-n, a-n };
+    int v = pushQuads(nullptr, 1);
+    writeQuad(v, corners, {}, _color);
+}
+
+void Renderer::drawText(const char* text, Vec2 pos) {
+    drawText(text, pos.x, pos.y);
+}
+void Renderer::drawText(const char* text, float x, float y) {
+    Vec2i pos {(int)x, (int)y};
+    // FNV-1a over the text, then mix in the position
+    Uint64 hash = 14695981039346656037ull;
+    int numGlyphs = 0;
+    for (const char* c = text; *c; ++c) {
+        hash = (hash ^ (Uint8)*c) * 1099511628211ull;
+        numGlyphs += *c >= 0;
+    }
+    hash = (hash ^ (Uint32)pos.x) * 1099511628211ull;
+    hash = (hash ^ (Uint32)pos.y) * 1099511628211ull;
+    if (numGlyphs == 0) {
+        return;
+    }
+
+    // the whole string goes in as one command
+    int v = pushQuads(_alphabetTexture, numGlyphs);
+
+    auto it = _textCache.find(hash);
+    if (it != _textCache.end() && it->second.pos.x == pos.x
+            && it->second.pos.y == pos.y && it->second.text == text) {
+        auto &cached = it->second;
+        cached.lastUsedFrame = _frame;
+        memcpy(&_rec->vertices[v], cached.vertices.data(),
+            cached.vertices.size() * sizeof(Vertex));
+        _stats.textCacheHits++;
+        return;
+    }
+
+    Vec2 alphabetSize = Vec2i{_alphabetTexture->w, _alphabetTexture->h}.to<float>();
+    int i = 0;
+    int w = (int)fontSize.x;
+    int h = (int)fontSize.y;
+    int q = 0;
+    while (char c = text[i++]) {
+        if (c < 0) {
+            // unsupported character; no extended ASCII tyvm
+            continue;
+        }
+        int j = c % 16;
+        int k = c / 16;
+        Rect src {Vec2i{j*w, k*h}.to<float>() / alphabetSize, fontSize / alphabetSize};
+        Rect dst {Vec2i{pos.x + (i-1)*w, pos.y}.to<float>(), fontSize};
+        writeRect(v + 4*q, dst, src, Color::white);
+        q++;
+    }
+
+    // on a collision this just replaces the old entry
+    auto &cached = _textCache[hash];
+    cached.text = text;
+    cached.pos = pos;
+    cached.vertices.assign(&_rec->vertices[v], &_rec->vertices[v] + 4*numGlyphs);
+    cached.lastUsedFrame = _frame;
+    _stats.textCacheMisses++;
+}
+
+void Renderer::trimTextCache() {
+    for (auto it = _textCache.begin(); it != _textCache.end();) {
+        if (_frame - it->second.lastUsedFrame > textCacheFrames) {
+            it = _textCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Renderer::drawImage(Texture *texture, float x, float y, float w, float h) {
+    drawImage(AtlasRegion {texture, {{0, 0}, {1, 1}}}, x, y, w, h);
+}
+void Renderer::drawImage(Texture *texture, Vec2 pos, Vec2 size) {
+    drawImage(texture, pos.x, pos.y, size.x, size.y);
+}
+void Renderer::drawImage(AtlasRegion region, float x, float y, float w, float h) {
+    int v = pushQuads(region.texture, 1);
+    writeRect(v, {{x, y}, {w, h}}, region.uv, Color::white);
+}
+void Renderer::drawImage(AtlasRegion region, Vec2 pos, Vec2 size) {
+    drawImage(region, pos.x, pos.y, size.x, size.y);
+}
+void Renderer::drawImage(TextureHandle texture, float x, float y, float w, float h) {
+    AtlasRegion region = _textures.get(texture);
+    if (region.texture) {
+        drawImage(region, x, y, w, h);
+    }
+}
+void Renderer::drawImage(TextureHandle texture, Vec2 pos, Vec2 size) {
+    drawImage(texture, pos.x, pos.y, size.x, size.y);
+}
+
+int Renderer::pushQuads(Texture* texture, int numQuads) {
+    _numDraws++;
+    int first = _rec->vertices.size();
+    _rec->vertices.resize(first + 4*numQuads);
+    if (!_rec->commands.empty()) {
+        auto &last = _rec->commands.back();
+        if (last.layer == _layer && last.texture == texture) {
+            last.numQuads += numQuads;
+            return first;
+        }
+    }
+    _rec->commands.push_back({_layer, texture, first, numQuads});
+    return first;
+}
+
+void Renderer::writeQuad(int vertex, const Vec2 corners[4], Rect uv, Color color) {
+    Vec2 uvs[4] {
+        uv.pos,
+        uv.pos + Vec2{uv.size.x, 0},
+        uv.pos + uv.size,
+        uv.pos + Vec2{0, uv.size.y},
+    };
+    for (int i = 0; i < 4; ++i) {
+        _rec->vertices[vertex+i] = {
+            corners[i],
+            color,
+            uvs[i],
+        };
+    }
+}
+void Renderer::writeRect(int vertex, Rect rect, Rect uv, Color color) {
+    // snap to whole pixels, to match how SDL_Rect-based drawing looked
+    Vec2 p = floorv(rect.pos).to<float>();
+    Vec2 s = Vec2i{(int)rect.size.x, (int)rect.size.y}.to<float>();
+    Vec2 corners[4] {
+        p,
+        p + Vec2{s.x, 0},
+        p + s,
+        p + Vec2{0, s.y},
+    };
+    writeQuad(vertex, corners, uv, color);
+}
+
+void Renderer::invalidate(Rect rect) {
+    SDL_LockMutex(_pendingLock);
+    _invalidRects.push_back(rect);
+    SDL_UnlockMutex(_pendingLock);
+}
+void Renderer::invalidateAll() {
+    SDL_LockMutex(_pendingLock);
+    _fullRedraw = true;
+    SDL_UnlockMutex(_pendingLock);
+}
+
+static Uint64 fnv1a(Uint64 hash, const void* data, size_t len) {
+    const Uint8* bytes = (const Uint8*)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void Renderer::hashQuads(FrameData const& frame) {
+    _quadKeys.clear();
+    _frameHash = 14695981039346656037ull;
+    for (auto &cmd : frame.commands) {
+        Uint64 state = fnv1a(14695981039346656037ull, &cmd.layer, sizeof(cmd.layer));
+        state = fnv1a(state, &cmd.texture, sizeof(cmd.texture));
+        for (int q = 0; q < cmd.numQuads; ++q) {
+            const Vertex* v = &frame.vertices[cmd.firstVertex + 4*q];
+            Uint64 hash = fnv1a(state, v, 4*sizeof(Vertex));
+            _frameHash = fnv1a(_frameHash, &hash, sizeof(hash));
+
+            Vec2 lo = min(min(v[0].pos, v[1].pos), min(v[2].pos, v[3].pos));
+            Vec2 hi = max(max(v[0].pos, v[1].pos), max(v[2].pos, v[3].pos));
+            // round out to whole pixels, with a pixel of slack for anything
+            // the rasterizer decides to touch along the edges
+            Vec2 p = floorv(lo).to<float>() - Vec2{1};
+            Vec2 size = ceilv(hi).to<float>() + Vec2{1} - p;
+            Vec2 uvLo = min(min(v[0].uv, v[1].uv), min(v[2].uv, v[3].uv));
+            Vec2 uvHi = max(max(v[0].uv, v[1].uv), max(v[2].uv, v[3].uv));
+            _quadKeys.push_back({hash, {p, size}, cmd.texture,
+                {uvLo, uvHi - uvLo}});
+        }
+    }
+}
+
+void Renderer::findDamage(FrameData const& frame, bool fullRedraw) {
+    Rect screen {{0, 0}, _targetSize};
+    bool bgChanged = memcmp(&frame.bgColor, &_prevBgColor, sizeof(Color)) != 0;
+    if (fullRedraw || bgChanged) {
+        _damage.clear();
+        _damage.add(screen);
+    } else if (_frameHash != _prevFrameHash) {
+        // diff the two frames as multisets of quads; anything without an
+        // exact match on the other side is damage, wherever it was or is now
+        auto byHash = [](QuadKey const& a, QuadKey const& b) {
+            return a.hash < b.hash;
+        };
+        // only sorted on demand; a frame identical to the last never gets here
+        std::vector<QuadKey> cur = _quadKeys;
+        std::sort(cur.begin(), cur.end(), byHash);
+        std::sort(_prevQuadKeys.begin(), _prevQuadKeys.end(), byHash);
+        int i = 0, j = 0;
+        int numChanged = 0;
+        while (i < cur.size() || j < _prevQuadKeys.size()) {
+            if (j >= _prevQuadKeys.size()
+                    || (i < cur.size() && cur[i].hash < _prevQuadKeys[j].hash)) {
+                _damage.add(cur[i++].bounds);
+                numChanged++;
+            } else if (i >= cur.size() || _prevQuadKeys[j].hash < cur[i].hash) {
+                _damage.add(_prevQuadKeys[j++].bounds);
+                numChanged++;
+            } else {
+                i++;
+                j++;
+            }
+        }
+        if (numChanged == 0) {
+            // same quads, different order, so overlaps may have changed.
+            // Rare enough not to bother narrowing down
+            _damage.clear();
+            _damage.add(screen);
+        }
+    }
+    // quads that look the same but sample pixels that changed under them
+    if (!_drawDirtyTexels.empty()) {
+        for (auto &key : _quadKeys) {
+            if (!key.texture) {
+                continue;
+            }
+            Vec2 texSize = Vec2i{key.texture->w, key.texture->h}.to<float>();
+            for (auto &dirty : _drawDirtyTexels) {
+                // touching counts, since filtering reads a texel past the edge
+                if (dirty.texture == key.texture && touches(key.uv,
+                        {dirty.rect.pos / texSize, dirty.rect.size / texSize})) {
+                    _damage.add(key.bounds);
+                    break;
+                }
+            }
+        }
+        _drawDirtyTexels.clear();
+    }
+    // past a point, one big pass beats several overlapping ones
+    if (_damage.area() > 0.5f * screen.size.x * screen.size.y) {
+        _damage.clear();
+        _damage.add(screen);
+    }
+
+    _prevBgColor = frame.bgColor;
+    _prevFrameHash = _frameHash;
+    std::swap(_prevQuadKeys, _quadKeys);
+}
+
+void Renderer::drawClipped(FrameData const& frame, Rect clip) {
+    Vec2 clipHi = clip.pos + clip.size;
+    // each run of commands with the same texture becomes one draw call,
+    // even across layers
+    for (int i = 0; i < frame.commands.size();) {
+        Texture* texture = frame.commands[i].texture;
+        _batchVertices.clear();
+        _batchIndices.clear();
+        for (; i < frame.commands.size() && frame.commands[i].texture == texture; ++i) {
+            auto &cmd = frame.commands[i];
+            for (int q = 0; q < cmd.numQuads; ++q) {
+                const Vertex* v = &frame.vertices[cmd.firstVertex + 4*q];
+                Vec2 lo = min(min(v[0].pos, v[1].pos), min(v[2].pos, v[3].pos));
+                Vec2 hi = max(max(v[0].pos, v[1].pos), max(v[2].pos, v[3].pos));
+                if (hi.x < clip.pos.x || lo.x > clipHi.x
+                        || hi.y < clip.pos.y || lo.y > clipHi.y) {
+                    continue;
+                }
+                int base = _batchVertices.size();
+                _batchVertices.insert(_batchVertices.end(), v, v+4);
+                for (int k : {0, 1, 2, 0, 2, 3}) {
+                    _batchIndices.push_back(base + k);
+                }
+            }
+        }
+        if (_batchIndices.empty()) {
+            continue;
+        }
+        drawGeometry(texture,
+            _batchVertices.data(), _batchVertices.size(),
+            _batchIndices.data(), _batchIndices.size());
+        _flushStats.drawCalls++;
+    }
+}
+
+void Renderer::groupByTexture(FrameData& frame) {
+    auto& commands = frame.commands;
+    _commandBounds.clear();
+    for (auto &cmd : commands) {
+        if (cmd.numQuads == 0) {
+            _commandBounds.push_back({});
+            continue;
+        }
+        const Vertex* v = &frame.vertices[cmd.firstVertex];
+        Vec2 lo = v[0].pos;
+        Vec2 hi = v[0].pos;
+        for (int k = 1; k < 4*cmd.numQuads; ++k) {
+            lo = min(lo, v[k].pos);
+            hi = max(hi, v[k].pos);
+        }
+        _commandBounds.push_back({lo, hi - lo});
+    }
+    auto overlaps = [](Rect a, Rect b) {
+        Rect r = intersect(a, b);
+        return r.size.x > 0 && r.size.y > 0;
+    };
+
+    // how far ahead to look for a match, so a frame of many small draws
+    // doesn't go quadratic
+    const int maxLookahead = 64;
+    for (int i = 0; i < commands.size(); ++i) {
+        DrawCommand cmd = commands[i];
+        int end = i + 1;
+        for (int j = i + 1; j < commands.size() && j <= i + maxLookahead; ++j) {
+            if (commands[j].layer != cmd.layer) {
+                break;
+            }
+            if (commands[j].texture != cmd.texture) {
+                continue;
+            }
+            // it'd jump everything in [end, j), so none of that can overlap it
+            bool blocked = false;
+            for (int k = end; k < j && !blocked; ++k) {
+                blocked = overlaps(_commandBounds[k], _commandBounds[j]);
+            }
+            if (blocked) {
+                continue;
+            }
+            std::rotate(commands.begin() + end, commands.begin() + j,
+                commands.begin() + j + 1);
+            std::rotate(_commandBounds.begin() + end,
+                _commandBounds.begin() + j, _commandBounds.begin() + j + 1);
+            end++;
+        }
+        i = end - 1;
+    }
+}
+
+void Renderer::flush(FrameData& frame, bool fullRedraw) {
+    _flushStats = {};
+
+    // sort by layer, then kind of texture; keep submission order otherwise
+    auto textureRank = [&](Texture* tex) {
+        // shapes, then images, then text on top
+        return tex == nullptr ? 0 : tex == _alphabetTexture ? 2 : 1;
+    };
+    std::stable_sort(frame.commands.begin(), frame.commands.end(),
+        [&](DrawCommand const& a, DrawCommand const& b) {
+            if (a.layer != b.layer) {
+                return a.layer < b.layer;
+            }
+            int ra = textureRank(a.texture);
+            int rb = textureRank(b.texture);
+            return ra < rb;
+        });
+    groupByTexture(frame);
+
+    hashQuads(frame);
+    findDamage(frame, fullRedraw);
+
+    Rect screen {{0, 0}, _targetSize};
+    for (Rect rect : _damage.rects()) {
+        Rect clip = intersect(rect, screen);
+        if (clip.size.x <= 0 || clip.size.y <= 0) {
+            continue;
+        }
+        setClip(&clip);
+        if (clip.size.x == screen.size.x && clip.size.y == screen.size.y) {
+            clear(frame.bgColor);
+        } else {
+            // clears ignore the clip rect in some backends, so fill instead
+            Vertex bg[4];
+            Vec2 corners[4] {
+                clip.pos,
+                clip.pos + Vec2{clip.size.x, 0},
+                clip.pos + clip.size,
+                clip.pos + Vec2{0, clip.size.y},
+            };
+            for (int k = 0; k < 4; ++k) {
+                bg[k] = { corners[k], frame.bgColor, {0, 0} };
+            }
+            const int indices[] { 0, 1, 2, 0, 2, 3 };
+            drawGeometry(nullptr, bg, 4, indices, 6);
+        }
+        drawClipped(frame, clip);
+        _flushStats.damageRects++;
+        _flushStats.redrawnPixels += int(clip.size.x * clip.size.y);
+    }
+    setClip(nullptr);
+    _damage.clear();
+}
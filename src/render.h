@@ -0,0 +1,374 @@
+// render.h - backend-independent Renderer interface; see doc/rendering.md
+
+#pragma once
+
+#include "color.h"
+#include "common.h"
+#include "damage.h"
+#include "textureManager.h"
+#include "vec.h"
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#define SMOL_TEXT true
+#if SMOL_TEXT
+    #define FONT_FILE "../data/alpha_small.png"
+    #define FONT_SIZE {8, 8}
+#else
+    #define FONT_FILE "../data/alpha.png"
+    #define FONT_SIZE {21, 12}
+#endif
+
+const Vec2 screenSize { 1920, 1080 };
+
+/// @brief Opaque handle to a texture owned by a Renderer. Each backend
+/// extends this with whatever it needs to actually draw it
+struct Texture {
+    int w, h;
+};
+
+/// @brief One corner of a triangle. Matches SDL_Vertex's layout, so batches
+/// can be handed to SDL as-is
+struct Vertex {
+    Vec2 pos;
+    Color color;
+    Vec2 uv; // normalized texture coordinates
+};
+
+/// @brief Coarse draw ordering. Draws aren't sent to the backend until
+/// `endFrame`, and within a layer they get grouped by texture: untextured
+/// shapes first, then images, then text. Submission order is only kept within
+/// a group, so draws with different textures that need to overlap a certain
+/// way should go on different layers
+enum RenderLayer {
+    layerBackground, // tiles, previews; anything the world draws over
+    layerWorld, // the default
+    layerUI,
+    layerOverlay,
+};
+
+/// @brief Records draws for a frame, then sorts and batches them into as few
+/// backend calls as possible. Backends (Renderer_SDL, Renderer_Soft) only
+/// implement textures and the handful of primitives at the bottom.
+///
+/// Backends draw into a target that persists between frames, so only what
+/// changed gets redrawn: each frame's quads are compared against the last
+/// frame's, and only the regions where they differ are cleared and drawn
+/// again. A frame identical to the last one draws nothing at all.
+///
+/// Drawing can happen on a separate render thread (see `startRenderThread`):
+/// `endFrame` hands the recorded frame over and returns right away, so the
+/// next frame's update runs while this one is drawn. Backend calls then only
+/// ever happen on the render thread; textures created or destroyed from the
+/// main thread get queued up for it.
+///
+/// The kernel constructs the renderer and the game just gets a pointer, so the
+/// vtable lives in the kernel and stays valid across game.dll reloads
+class Renderer {
+protected:
+    Texture* _alphabetTexture = nullptr;
+    TextureHandle _font;
+    TextureManager _textures {this};
+    Vec2 _targetSize = screenSize;
+
+private:
+    Color _bgColor;
+    Color _color;
+    int _layer = layerWorld;
+
+    // a recorded draw; one or more quads sharing the same state
+    struct DrawCommand {
+        int layer;
+        Texture* texture; // nullptr for untextured shapes
+        int firstVertex; // index into `vertices`
+        int numQuads; // 4 vertices each
+    };
+    // everything recorded for one frame; handed to the render thread whole
+    struct FrameData {
+        Uint32 frame;
+        Color bgColor;
+        std::vector<DrawCommand> commands;
+        std::vector<Vertex> vertices;
+    };
+    // triple buffer: the main thread records into one slot while the render
+    // thread draws from another, and the third holds the newest finished
+    // frame. Each side trades slots with the shared one by atomic exchange,
+    // so neither ever waits on the other. If the main thread gets ahead, the
+    // render thread skips straight to the newest frame
+    FrameData _frames[3];
+    FrameData* _rec = &_frames[0]; // being recorded
+    int _recIdx = 0; // main thread only
+    int _drawIdx = 1; // render thread only
+    std::atomic<int> _readyIdx {2}; // plus `frameFresh` if not drawn yet
+    static const int frameFresh = 4;
+
+    SDL_Thread* _thread = nullptr;
+    SDL_sem* _framePosted = nullptr;
+    // posted once the render thread has attached, or failed to
+    SDL_sem* _threadReady = nullptr;
+    std::atomic<bool> _threadAttached {false};
+    std::atomic<bool> _stopThread {false};
+
+    // individual draw calls recorded this frame, before merging
+    int _numDraws = 0;
+    // textures created or updated since the last endFrame
+    int _numUploads = 0;
+    // scratch space for building batches in `flush`, kept to avoid reallocating
+    std::vector<Vertex> _batchVertices;
+    std::vector<int> _batchIndices;
+    // each command's bounds, for `groupByTexture`
+    std::vector<Rect> _commandBounds;
+
+    // changes to hand over to whichever thread draws next; guarded by
+    // _pendingLock, since either side can add to them at any time
+    struct TextureOp {
+        Texture* texture;
+        SDL_Surface* surface; // pixels to upload, or null to destroy
+        Uint32 frame; // destroys wait until this frame has been drawn
+        bool partial; // upload into an existing texture, at `pos`
+        Vec2i pos;
+    };
+    SDL_mutex* _pendingLock;
+    std::vector<TextureOp> _textureOps;
+    std::vector<Rect> _invalidRects;
+    // parts of textures whose pixels changed, in texels; whatever samples
+    // them has to be redrawn
+    struct DirtyTexels {
+        Texture* texture;
+        Rect rect;
+    };
+    std::vector<DirtyTexels> _dirtyTexels;
+    bool _fullRedraw = true;
+    // taken out from under the lock before drawing
+    std::vector<TextureOp> _drawOps;
+    std::vector<DirtyTexels> _drawDirtyTexels;
+
+    // glyph quads for strings drawn recently, keyed by a hash of the text and
+    // position, so static labels don't need rebuilding each frame
+    struct CachedText {
+        std::string text; // to rule out hash collisions
+        Vec2i pos;
+        std::vector<Vertex> vertices;
+        Uint32 lastUsedFrame;
+    };
+    std::unordered_map<Uint64, CachedText> _textCache;
+    Uint32 _frame = 0;
+    // entries unused for this many frames get evicted
+    static const Uint32 textCacheFrames = 120;
+
+    // a quad as drawn, for finding what changed since last frame
+    struct QuadKey {
+        Uint64 hash; // of its vertices, layer and texture
+        Rect bounds;
+        Texture* texture;
+        Rect uv; // normalized
+    };
+    std::vector<QuadKey> _quadKeys, _prevQuadKeys;
+    Uint64 _frameHash = 0, _prevFrameHash = 0; // of all quads, in draw order
+    Color _prevBgColor;
+    DamageList _damage;
+
+    // input-to-present latency. Frames showing new input wait here until a
+    // frame at least as new gets presented; one skipped by the render thread
+    // counts as shown by whichever replaces it
+    struct PendingInput {
+        Uint32 frame;
+        Uint32 timestamp; // SDL_GetTicks of the oldest input it shows
+    };
+    std::vector<PendingInput> _pendingInput; // main thread only
+    Uint32 _inputTimestamp = 0; // for the frame being recorded
+    // the newest frame presented, in the high half, and SDL_GetTicks as of
+    // presenting it in the low half, so they're read together
+    std::atomic<Uint64> _presented {0};
+    // 1ms buckets; the last is overflow
+    static const int numLatencyBuckets = 200;
+    int _latencyHist[numLatencyBuckets] = {};
+    int _numLatencies = 0;
+
+public:
+    struct Stats {
+        int commands; // draws as recorded, i.e. what it'd cost unbatched
+        int drawCalls; // backend geometry calls actually made
+        int textCacheHits;
+        int textCacheMisses;
+        int damageRects;
+        int redrawnPixels;
+        int textureUploads; // requested since the frame before
+    };
+
+private:
+    Stats _stats {}; // the recording half
+    Stats _flushStats {}; // the drawing half, as it's being counted
+    Stats _drawStats {}; // and once it's done; guarded by _pendingLock
+
+public:
+    Renderer();
+    virtual ~Renderer();
+
+    void startFrame();
+    /// @brief Finishes recording; draws and presents the frame, or hands it
+    /// to the render thread to do that
+    void endFrame();
+
+    /// @brief Moves drawing onto its own thread from here on. The backend
+    /// must not be used from any other thread while it runs
+    /// @return whether the render thread is running
+    bool startRenderThread();
+    /// @brief Waits for the render thread to finish, then goes back to
+    /// drawing on the calling thread, if the backend can follow it there
+    void stopRenderThread();
+
+    /// @brief Marks the frame being recorded as showing input from this
+    /// SDL timestamp on, e.g. from `Input::takeInputTimestamp`; 0 for none
+    void setInputTimestamp(Uint32 timestamp);
+    /// @brief Latency at or below which `pct` of all input got presented
+    float inputLatencyMs(float pct) const;
+    /// @brief Logs input-to-present latency percentiles
+    void logLatencyReport();
+
+    /// @brief Counters from the most recently finished frame. With a render
+    /// thread, the drawing counters can lag a frame or two behind
+    Stats stats() const;
+
+    /// @brief Shared, refcounted textures; prefer these to creating and
+    /// destroying textures directly
+    TextureManager& textures();
+
+    /// @brief The pixel format textures are stored in. Surfaces already in it
+    /// upload with a straight copy; anything else gets converted first
+    virtual Uint32 pixelFormat() const = 0;
+    /// @brief A blank 32-bit surface in `pixelFormat`, to generate pixels
+    /// into with a PixelWriter. Free it with SDL_FreeSurface
+    SDL_Surface* createSurface(int w, int h) const;
+
+    /// @brief Creates a texture with a copy of the surface's pixels
+    Texture* createTexture(SDL_Surface* surface);
+    void destroyTexture(Texture* texture);
+    /// @brief Copies the surface's pixels into part of an existing texture
+    /// @param pos where the surface's upper-left corner goes
+    void updateTexture(Texture* texture, SDL_Surface* surface, Vec2i pos);
+    /// @brief Loads an image file into a new texture
+    /// @return nullptr if the file couldn't be loaded
+    Texture* loadTexture(const char* filename);
+
+    void background(Color c);
+
+    /// @brief Sets the layer for subsequent draws
+    /// @return the previous layer, for restoring afterwards
+    int setLayer(int layer);
+
+    void setColor(float r, float g, float b, float a = 1.0f);
+    void setColor(Color c);
+    void drawRect(float x, float y, float w, float h);
+    void drawRect(Vec2 pos, Vec2 size);
+    void drawRect(Rect rect);
+    void drawBox(float x, float y, float w, float h);
+    void drawBox(Vec2 pos, Vec2 size);
+    void drawBox(Rect rect);
+
+    void drawLine(Vec2 a, Vec2 b);
+
+    static const Vec2 fontSize;
+    void drawText(const char* text, Vec2 pos);
+    void drawText(const char* text, float x, float y);
+
+    void drawImage(Texture *texture, float x, float y, float w, float h);
+    void drawImage(Texture *texture, Vec2 pos, Vec2 size);
+    void drawImage(AtlasRegion region, float x, float y, float w, float h);
+    void drawImage(AtlasRegion region, Vec2 pos, Vec2 size);
+    /// @brief Draws nothing if the handle is null or stale
+    void drawImage(TextureHandle texture, float x, float y, float w, float h);
+    void drawImage(TextureHandle texture, Vec2 pos, Vec2 size);
+
+    /// @brief Forces a region to be redrawn next frame. Only needed for
+    /// changes the renderer can't see in the draws themselves
+    void invalidate(Rect rect);
+    /// @brief Forces the whole screen to be redrawn next frame
+    void invalidateAll();
+
+protected:
+    // backend primitives. Apart from `allocTexture`, these are only called
+    // from whichever thread is drawing
+
+    /// @brief Makes a handle for a texture that'll get its pixels later;
+    /// shouldn't touch the backend
+    virtual Texture* allocTexture(int w, int h) = 0;
+    virtual void uploadTexture(Texture* texture, SDL_Surface* surface) = 0;
+    /// @brief Overwrites part of a texture that's already been uploaded
+    virtual void uploadTextureRegion(Texture* texture, SDL_Surface* surface,
+        Vec2i pos) = 0;
+    virtual void freeTexture(Texture* texture) = 0;
+
+    virtual void clear(Color color) = 0;
+    /// @brief Restricts drawing to a rect, or removes the restriction if null
+    virtual void setClip(const Rect* clip) = 0;
+    /// @brief Draws a list of triangles, three indices per triangle
+    /// @param texture nullptr for untextured, vertex colors only
+    virtual void drawGeometry(Texture* texture,
+        const Vertex* vertices, int numVertices,
+        const int* indices, int numIndices) = 0;
+    virtual void present() = 0;
+    /// @brief Called on the render thread before it draws anything, and
+    /// before `startRenderThread` returns; for backends that have to be
+    /// set up on the thread that uses them
+    /// @return false to draw inline instead
+    virtual bool attachThread() { return true; }
+    /// @brief Called on the render thread once it's drawn its last frame and
+    /// finished off any queued texture work
+    virtual void detachThread() {}
+    /// @brief Counts latency for input in every frame presented so far
+    void resolveInputLatency();
+
+    /// @brief Backends call these from their constructor/destructor, since
+    /// creating textures needs the backend to exist. `unloadFont` also frees
+    /// whatever's left in the TextureManager
+    void loadFont();
+    void unloadFont();
+
+private:
+    /// @brief Starts a new command, or extends the last one if it has the same state
+    /// @return the index to write the new quad's vertices at
+    int pushQuads(Texture* texture, int numQuads);
+    /// @param corners clockwise from the upper-left
+    /// @param uv texture coordinates, normalized to [0, 1]
+    void writeQuad(int vertex, const Vec2 corners[4], Rect uv, Color color);
+    void writeRect(int vertex, Rect rect, Rect uv, Color color);
+
+    /// @brief Evicts cached text that hasn't been drawn in a while
+    void trimTextCache();
+
+    /// @brief Queues up a copy of the surface for the render thread, or
+    /// uploads it right away if there isn't one
+    void queueUpload(Texture* texture, SDL_Surface* surface, bool partial,
+        Vec2i pos);
+    /// @brief Runs a queued upload
+    void upload(TextureOp& op);
+
+    static int renderThread(void* renderer);
+    /// @brief Applies pending texture changes around drawing the frame
+    void drawFrame(FrameData& frame);
+    /// @brief Runs every queued upload and free, regardless of frame
+    void finishTextureOps();
+
+    /// @brief Pulls commands forward to join earlier ones with the same
+    /// texture, within a layer and rank, but never past one they overlap,
+    /// so whatever overlaps is still drawn in submission order
+    void groupByTexture(FrameData& frame);
+    /// @brief Hashes each quad in draw order, into `_quadKeys` and `_frameHash`
+    void hashQuads(FrameData const& frame);
+    /// @brief Fills `_damage` with everywhere this frame differs from the last
+    void findDamage(FrameData const& frame, bool fullRedraw);
+    /// @brief Sends every quad overlapping `clip` to the backend, batched by
+    /// texture; commands must already be sorted
+    void drawClipped(FrameData const& frame, Rect clip);
+
+    /// @brief Sorts and batches the frame's commands, then sends whatever
+    /// changed to the backend
+    void flush(FrameData& frame, bool fullRedraw);
+};
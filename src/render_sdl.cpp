@@ -1,99 +1,146 @@
 #include "render_sdl.h"
 
-#define SMOL_TEXT true
-#if SMOL_TEXT
-    #define FONT_FILE "../data/alpha_small.png"
-    #define FONT_SIZE {8, 8}
-#else
-    #define FONT_FILE "../data/alpha.png"
-    #define FONT_SIZE {21, 12}
-#endif
-
-const Vec2 Renderer::fontSize = FONT_SIZE;
-
-Renderer::Renderer(SDL_Renderer* sdl) : _sdlRenderer(sdl) {
-    const char* filename = FONT_FILE;
-    SDL_Surface *surf = IMG_Load(filename);
-    assert(surf, "%s failed to load", filename);
-    _alphabetTexture = SDL_CreateTextureFromSurface(_sdlRenderer, surf);
-    SDL_FreeSurface(surf);
+Renderer_SDL::Renderer_SDL(SDL_Window* window, bool renderThread)
+        : _window(window) {
+    // before the font, whose upload has to happen wherever drawing does
+    if (!renderThread || !startRenderThread()) {
+        assert_SDL(attachThread(), "renderer creation failed");
+    }
+    loadFont();
 }
 
-Renderer::~Renderer() {
-    SDL_DestroyTexture(_alphabetTexture);
+Renderer_SDL::~Renderer_SDL() {
+    stopRenderThread();
+    unloadFont();
+    detachThread();
 }
 
-SDL_Renderer* Renderer::sdl() const {
-    return _sdlRenderer;
+bool Renderer_SDL::attachThread() {
+    _sdlRenderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED);
+    if (!_sdlRenderer) {
+        log("failed to create renderer: %s", SDL_GetError());
+        return false;
+    }
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(_sdlRenderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+            Uint32 format = info.texture_formats[i];
+            if (SDL_BITSPERPIXEL(format) == 32 && SDL_ISPIXELFORMAT_ALPHA(format)) {
+                _format = format;
+                break;
+            }
+        }
+    }
+    _target = SDL_CreateTexture(_sdlRenderer, SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_TARGET, _targetSize.x, _targetSize.y);
+    if (_target) {
+        SDL_SetRenderTarget(_sdlRenderer, _target);
+    } else {
+        log("no render target, redrawing every frame: %s", SDL_GetError());
+    }
+    return true;
 }
 
-void Renderer::startFrame() {
-    setColor(_bgColor);
-    SDL_RenderClear(_sdlRenderer);
-}
-void Renderer::endFrame() {
-    SDL_RenderPresent(_sdlRenderer);
+void Renderer_SDL::detachThread() {
+    if (!_sdlRenderer) {
+        return;
+    }
+    // takes every texture it created along with it
+    SDL_DestroyRenderer(_sdlRenderer);
+    _sdlRenderer = nullptr;
+    _target = nullptr;
 }
 
-void Renderer::background(Color c) {
-    _bgColor = c;
+Uint32 Renderer_SDL::pixelFormat() const {
+    return _format;
 }
 
-void Renderer::setColor(float r, float g, float b, float a) {
-    SDL_SetRenderDrawColor(_sdlRenderer, 255*r, 255*g, 255*b, 255*a);
-}
-void Renderer::setColor(Color c) {
-    SDL_SetRenderDrawColor(_sdlRenderer, c.r, c.g, c.b, c.a);
-}
-void Renderer::drawRect(float x, float y, float w, float h) {
-    SDL_Rect rect {(int)x,(int)y,(int)w,(int)h};
-    SDL_RenderFillRect(_sdlRenderer, &rect);
-}
-void Renderer::drawRect(Vec2 pos, Vec2 size) {
-    drawRect(pos.x, pos.y, size.x, size.y);
-}
-void Renderer::drawRect(Rect rect) {
-    drawRect(rect.pos.x, rect.pos.y, rect.size.x, rect.size.y);
-}
-void Renderer::drawBox(float x, float y, float w, float h) {
-    SDL_Rect rect {(int)x, (int)y, (int)w, (int)h};
-    SDL_RenderDrawRect(_sdlRenderer, &rect);
-}
-void Renderer::drawBox(Vec2 pos, Vec2 size) {
-    drawBox(pos.x, pos.y, size.x, size.y);
+Texture* Renderer_SDL::allocTexture(int w, int h) {
+    return new Texture_SDL { {w, h}, nullptr };
+}
+void Renderer_SDL::uploadTexture(Texture* texture, SDL_Surface* surface) {
+    auto tex = (Texture_SDL*)texture;
+    tex->sdl = SDL_CreateTexture(_sdlRenderer, _format, SDL_TEXTUREACCESS_STATIC,
+        texture->w, texture->h);
+    if (!tex->sdl) {
+        log("failed to create texture: %s", SDL_GetError());
+        return;
+    }
+    SDL_SetTextureBlendMode(tex->sdl, SDL_BLENDMODE_BLEND);
+    uploadTextureRegion(texture, surface, {0, 0});
+}
+void Renderer_SDL::uploadTextureRegion(Texture* texture, SDL_Surface* surface,
+        Vec2i pos) {
+    auto tex = (Texture_SDL*)texture;
+    if (!tex->sdl) {
+        return;
+    }
+    // SDL_UpdateTexture doesn't convert; surfaces made with createSurface
+    // are already in our format, and copy straight across
+    SDL_Surface* converted = surface;
+    if (surface->format->format != _format) {
+        converted = SDL_ConvertSurfaceFormat(surface, _format, 0);
+        if (!converted) {
+            log("failed to convert surface: %s", SDL_GetError());
+            return;
+        }
+    }
+    SDL_Rect rect { pos.x, pos.y, converted->w, converted->h };
+    if (SDL_UpdateTexture(tex->sdl, &rect, converted->pixels, converted->pitch) != 0) {
+        log("failed to update texture: %s", SDL_GetError());
+    }
+    if (converted != surface) {
+        SDL_FreeSurface(converted);
+    }
 }
-void Renderer::drawBox(Rect rect) {
-    drawBox(rect.pos.x, rect.pos.y, rect.size.x, rect.size.y);
+void Renderer_SDL::freeTexture(Texture* texture) {
+    auto tex = (Texture_SDL*)texture;
+    // already gone if the SDL_Renderer is
+    if (tex->sdl && _sdlRenderer) {
+        SDL_DestroyTexture(tex->sdl);
+    }
+    delete tex;
 }
 
-void Renderer::drawLine(Vec2 a, Vec2 b) {
-    SDL_RenderDrawLine(_sdlRenderer, a.x, a.y, b.x, b.y);
+void Renderer_SDL::clear(Color color) {
+    SDL_SetRenderDrawColor(_sdlRenderer, color.r, color.g, color.b, color.a);
+    SDL_RenderClear(_sdlRenderer);
 }
 
-void Renderer::drawText(const char* text, Vec2 pos) {
-    drawText(text, pos.x, pos.y);
+void Renderer_SDL::setClip(const Rect* clip) {
+    if (!clip) {
+        SDL_RenderSetClipRect(_sdlRenderer, nullptr);
+        return;
+    }
+    Vec2i lo = floorv(clip->pos);
+    Vec2i hi = ceilv(clip->pos + clip->size);
+    SDL_Rect rect { lo.x, lo.y, hi.x - lo.x, hi.y - lo.y };
+    SDL_RenderSetClipRect(_sdlRenderer, &rect);
 }
-void Renderer::drawText(const char* text, float x, float y) {
-    int i = 0;
-    int w = (int)fontSize.x;
-    int h = (int)fontSize.y;
-    while (char c = text[i++]) {
-        if (c < 0) {
-            // unsupported character; no extended ASCII tyvm
-            continue;
+
+void Renderer_SDL::drawGeometry(Texture* texture,
+        const Vertex* vertices, int numVertices,
+        const int* indices, int numIndices) {
+    SDL_Texture* sdl = nullptr;
+    if (texture) {
+        sdl = ((Texture_SDL*)texture)->sdl;
+        if (!sdl) {
+            return; // failed to upload; drawing it untextured would be worse
         }
-        int j = c % 16;
-        int k = c / 16;
-        SDL_Rect srcRect {j*w, k*h, w, h};
-        SDL_Rect dstRect {(int)x + (i-1)*w, (int)y, w, h};
-        SDL_RenderCopy(_sdlRenderer, _alphabetTexture, &srcRect, &dstRect);
     }
+    SDL_RenderGeometry(_sdlRenderer, sdl,
+        (const SDL_Vertex*)vertices, numVertices,
+        indices, numIndices);
 }
 
-void Renderer::drawImage(SDL_Texture *texture, float x, float y, float w, float h) {
-    SDL_Rect destRect { (int)x, (int)y, (int)w, (int)h };
-    SDL_RenderCopy(_sdlRenderer, texture, nullptr, &destRect);
-}
-void Renderer::drawImage(SDL_Texture *texture, Vec2 pos, Vec2 size) {
-    drawImage(texture, pos.x, pos.y, size.x, size.y);
+void Renderer_SDL::present() {
+    if (!_target) {
+        SDL_RenderPresent(_sdlRenderer);
+        invalidateAll();
+        return;
+    }
+    SDL_SetRenderTarget(_sdlRenderer, nullptr);
+    SDL_RenderCopy(_sdlRenderer, _target, nullptr, nullptr);
+    SDL_RenderPresent(_sdlRenderer);
+    SDL_SetRenderTarget(_sdlRenderer, _target);
 }
@@ -1,54 +1,55 @@
+// render_sdl.h - Renderer backend using SDL_Renderer
+
 #pragma once
 
-#include "color.h"
-#include "common.h"
-#include "vec.h"
+#include "render.h"
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-
-#define SMOL_TEXT true
-#if SMOL_TEXT
-    #define FONT_FILE "../data/alpha_small.png"
-    #define FONT_SIZE {8, 8}
-#else
-    #define FONT_FILE "../data/alpha.png"
-    #define FONT_SIZE {21, 12}
-#endif
 
-class Renderer {
-    SDL_Renderer* _sdlRenderer;
-    SDL_Texture *_alphabetTexture;
+struct Texture_SDL : public Texture {
+    SDL_Texture* sdl;
+};
 
-    Color _bgColor;
+/// SDL's render API is only safe on the thread that created the SDL_Renderer,
+/// so with a render thread the SDL_Renderer gets created on it, and every
+/// SDL_Renderer call follows. Texture creation goes through the same queue as
+/// uploads. Once that thread stops, the SDL_Renderer goes with it, and all
+/// that's left to do is free textures; stop it only at shutdown
+class Renderer_SDL : public Renderer {
+    SDL_Window* _window;
+    SDL_Renderer* _sdlRenderer = nullptr;
+    // what we actually draw into; the backbuffer's contents are undefined
+    // after presenting, so keeping unchanged pixels needs a target of our own.
+    // Null if the driver can't render to textures
+    SDL_Texture* _target = nullptr;
+    // what textures get created as; the first 32-bit format with alpha the
+    // driver lists, which is the one it's fastest at
+    Uint32 _format = SDL_PIXELFORMAT_ARGB8888;
 
 public:
-    Renderer(SDL_Renderer* sdl);
-
-    ~Renderer();
-
-    SDL_Renderer* sdl() const;
-
-    void startFrame();
-    void endFrame();
-
-    void background(Color c);
-
-    void setColor(float r, float g, float b, float a = 1.0f);
-    void setColor(Color c);
-    void drawRect(float x, float y, float w, float h);
-    void drawRect(Vec2 pos, Vec2 size);
-    void drawRect(Rect rect);
-    void drawBox(float x, float y, float w, float h);
-    void drawBox(Vec2 pos, Vec2 size);
-    void drawBox(Rect rect);
-
-    void drawLine(Vec2 a, Vec2 b);
-
-    static const Vec2 fontSize;
-    void drawText(const char* text, Vec2 pos);
-    void drawText(const char* text, float x, float y);
-
-    void drawImage(SDL_Texture *texture, float x, float y, float w, float h);
-    void drawImage(SDL_Texture *texture, Vec2 pos, Vec2 size);
+    /// @param window owned by the caller, and must outlive this
+    /// @param renderThread whether to start drawing on a render thread right
+    /// away, since the SDL_Renderer can't move there later
+    Renderer_SDL(SDL_Window* window, bool renderThread);
+    ~Renderer_SDL();
+
+    Uint32 pixelFormat() const override;
+
+protected:
+    Texture* allocTexture(int w, int h) override;
+    void uploadTexture(Texture* texture, SDL_Surface* surface) override;
+    void uploadTextureRegion(Texture* texture, SDL_Surface* surface,
+        Vec2i pos) override;
+    void freeTexture(Texture* texture) override;
+
+    void clear(Color color) override;
+    void setClip(const Rect* clip) override;
+    void drawGeometry(Texture* texture,
+        const Vertex* vertices, int numVertices,
+        const int* indices, int numIndices) override;
+    void present() override;
+    /// @brief Creates the SDL_Renderer, on whichever thread will draw
+    bool attachThread() override;
+    /// @brief Destroys the SDL_Renderer, and every texture with it
+    void detachThread() override;
 };
@@ -0,0 +1,269 @@
+#include "render_soft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+Renderer_Soft::Renderer_Soft(Vec2i size) : _size(size) {
+    _pixels.resize(_size.x * _size.y);
+    _targetSize = _size.to<float>();
+    setClip(nullptr);
+    loadFont();
+}
+
+Renderer_Soft::~Renderer_Soft() {
+    stopRenderThread();
+    unloadFont();
+}
+
+Vec2i Renderer_Soft::size() const {
+    return _size;
+}
+const Color* Renderer_Soft::pixels() const {
+    return _pixels.data();
+}
+Color Renderer_Soft::pixel(int x, int y) const {
+    return _pixels[y*_size.x + x];
+}
+
+Uint32 Renderer_Soft::pixelFormat() const {
+    // the same byte order as Color, so textures are just Colors
+    return SDL_PIXELFORMAT_RGBA32;
+}
+
+Texture* Renderer_Soft::allocTexture(int w, int h) {
+    auto tex = new Texture_Soft { {w, h} };
+    // transparent until uploaded
+    tex->pixels.resize(w * h);
+    return tex;
+}
+void Renderer_Soft::uploadTexture(Texture* texture, SDL_Surface* surface) {
+    uploadTextureRegion(texture, surface, {0, 0});
+}
+void Renderer_Soft::uploadTextureRegion(Texture* texture, SDL_Surface* surface,
+        Vec2i pos) {
+    auto tex = (Texture_Soft*)texture;
+    // anything hanging off the texture gets clipped, which may be all of it
+    if (pos.x < 0 || pos.y < 0 || pos.x >= tex->w || pos.y >= tex->h) {
+        return;
+    }
+    // normalize whatever we're given to byte-order RGBA, same as Color
+    SDL_Surface* rgba = surface;
+    if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+        rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (!rgba) {
+            log("failed to convert surface: %s", SDL_GetError());
+            return;
+        }
+    }
+    int w = min(rgba->w, tex->w - pos.x);
+    int h = min(rgba->h, tex->h - pos.y);
+    for (int y = 0; y < h; ++y) {
+        memcpy(&tex->pixels[(pos.y + y)*tex->w + pos.x],
+            (Uint8*)rgba->pixels + y*rgba->pitch, w * sizeof(Color));
+    }
+    if (rgba != surface) {
+        SDL_FreeSurface(rgba);
+    }
+}
+void Renderer_Soft::freeTexture(Texture* texture) {
+    delete (Texture_Soft*)texture;
+}
+
+bool Renderer_Soft::saveBMP(const char* filename) const {
+    SDL_Surface* surf = SDL_CreateRGBSurfaceWithFormatFrom((void*)_pixels.data(),
+        _size.x, _size.y, 32, _size.x * sizeof(Color), SDL_PIXELFORMAT_RGBA32);
+    if (!surf) {
+        return false;
+    }
+    bool ok = SDL_SaveBMP(surf, filename) == 0;
+    SDL_FreeSurface(surf);
+    return ok;
+}
+
+int Renderer_Soft::diffImage(const char* filename, int tolerance) const {
+    SDL_Surface* loaded = SDL_LoadBMP(filename);
+    if (!loaded) {
+        return -1;
+    }
+    SDL_Surface* rgba = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    if (!rgba) {
+        return -1;
+    }
+    if (rgba->w != _size.x || rgba->h != _size.y) {
+        SDL_FreeSurface(rgba);
+        return -1;
+    }
+    int mismatched = 0;
+    for (int y = 0; y < _size.y; ++y) {
+        const Color* row = (const Color*)((Uint8*)rgba->pixels + y*rgba->pitch);
+        for (int x = 0; x < _size.x; ++x) {
+            Color a = row[x];
+            Color b = _pixels[y*_size.x + x];
+            if (abs(a.r - b.r) > tolerance || abs(a.g - b.g) > tolerance
+                    || abs(a.b - b.b) > tolerance) {
+                mismatched++;
+            }
+        }
+    }
+    SDL_FreeSurface(rgba);
+    return mismatched;
+}
+
+void Renderer_Soft::logTimings() const {
+    const char* names[] = { "clear", "shapes", "images", "text" };
+    log("software renderer: %d frames, %dx%d", numFrames, _size.x, _size.y);
+    int frames = max(numFrames, 1);
+    for (int i = 0; i < numPrimitiveKinds; ++i) {
+        auto &t = totalTiming[i];
+        log("  %-7s %6.3fms/frame  %5d calls  %7d tris", names[i],
+            t.ms / frames, t.calls / frames, t.triangles / frames);
+    }
+}
+
+void Renderer_Soft::clear(Color color) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (auto &p : _pixels) {
+        p = color;
+    }
+    record(primClear, 0, start);
+}
+
+void Renderer_Soft::setClip(const Rect* clip) {
+    _clipLo = {0, 0};
+    _clipHi = _size - Vec2i{1, 1};
+    if (clip) {
+        _clipLo = max(_clipLo, floorv(clip->pos));
+        _clipHi = min(_clipHi, ceilv(clip->pos + clip->size) - Vec2i{1, 1});
+    }
+}
+
+void Renderer_Soft::drawGeometry(Texture* texture,
+        const Vertex* vertices, int numVertices,
+        const int* indices, int numIndices) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    auto tex = (const Texture_Soft*)texture;
+    for (int i = 0; i+2 < numIndices; i += 3) {
+        drawTriangle(tex,
+            vertices[indices[i]], vertices[indices[i+1]], vertices[indices[i+2]]);
+    }
+    PrimitiveKind kind = texture == nullptr ? primShapes
+        : texture == _alphabetTexture ? primText
+        : primImages;
+    record(kind, numIndices / 3, start);
+}
+
+void Renderer_Soft::present() {
+    for (int i = 0; i < numPrimitiveKinds; ++i) {
+        auto &total = totalTiming[i];
+        auto &frame = frameTiming[i];
+        total.calls += frame.calls;
+        total.triangles += frame.triangles;
+        total.ms += frame.ms;
+        frame = {};
+    }
+    numFrames++;
+}
+
+void Renderer_Soft::record(PrimitiveKind kind, int triangles, Uint64 start) {
+    auto &t = frameTiming[kind];
+    t.calls++;
+    t.triangles += triangles;
+    t.ms += 1000.0 * (SDL_GetPerformanceCounter() - start) / _freq;
+}
+
+// twice the signed area of abc; positive when clockwise in screen space
+static float edge(Vec2 a, Vec2 b, Vec2 c) {
+    return (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+}
+
+// top-left fill rule: pixels exactly on a shared edge belong to only one of
+// the two triangles, so nothing gets blended twice
+static bool isTopLeft(Vec2 a, Vec2 b) {
+    bool top = a.y == b.y && b.x > a.x;
+    bool left = b.y < a.y;
+    return top || left;
+}
+
+static Uint8 mul8(int a, int b) {
+    return Uint8((a*b + 127) / 255);
+}
+
+void Renderer_Soft::drawTriangle(const Texture_Soft* texture,
+        const Vertex& a, const Vertex& b, const Vertex& c) {
+    const Vertex* v[3] { &a, &b, &c };
+    float area = edge(a.pos, b.pos, c.pos);
+    if (area == 0) {
+        return;
+    }
+    if (area < 0) {
+        // rewind so the edge functions are positive inside
+        v[1] = &c;
+        v[2] = &b;
+        area = -area;
+    }
+    Vec2 p0 = v[0]->pos, p1 = v[1]->pos, p2 = v[2]->pos;
+
+    // pixel centers covered by the bounding box, clipped
+    int x0 = max(_clipLo.x, (int)floorf(min(p0.x, min(p1.x, p2.x))));
+    int y0 = max(_clipLo.y, (int)floorf(min(p0.y, min(p1.y, p2.y))));
+    int x1 = min(_clipHi.x, (int)ceilf(max(p0.x, max(p1.x, p2.x))));
+    int y1 = min(_clipHi.y, (int)ceilf(max(p0.y, max(p1.y, p2.y))));
+
+    bool tl0 = isTopLeft(p1, p2);
+    bool tl1 = isTopLeft(p2, p0);
+    bool tl2 = isTopLeft(p0, p1);
+
+    // rects are the common case; skip interpolating when nothing varies
+    bool flatColor = memcmp(&v[0]->color, &v[1]->color, sizeof(Color)) == 0
+        && memcmp(&v[0]->color, &v[2]->color, sizeof(Color)) == 0;
+
+    for (int y = y0; y <= y1; ++y) {
+        Color* row = &_pixels[y*_size.x];
+        for (int x = x0; x <= x1; ++x) {
+            Vec2 p { x + 0.5f, y + 0.5f };
+            float w0 = edge(p1, p2, p);
+            float w1 = edge(p2, p0, p);
+            float w2 = edge(p0, p1, p);
+            if (w0 < 0 || w1 < 0 || w2 < 0
+                    || (w0 == 0 && !tl0) || (w1 == 0 && !tl1) || (w2 == 0 && !tl2)) {
+                continue;
+            }
+            w0 /= area;
+            w1 /= area;
+            w2 /= area;
+
+            Color src = v[0]->color;
+            if (!flatColor) {
+                auto interp = [&](Uint8 Color::*ch) {
+                    return Uint8(w0*(v[0]->color.*ch) + w1*(v[1]->color.*ch)
+                        + w2*(v[2]->color.*ch) + 0.5f);
+                };
+                src = { interp(&Color::r), interp(&Color::g),
+                    interp(&Color::b), interp(&Color::a) };
+            }
+            if (texture) {
+                // nearest-neighbor sample, modulated by the vertex color
+                Vec2 uv = w0*v[0]->uv + w1*v[1]->uv + w2*v[2]->uv;
+                int tx = clamp((int)(uv.x * texture->w), 0, texture->w-1);
+                int ty = clamp((int)(uv.y * texture->h), 0, texture->h-1);
+                Color t = texture->pixels[ty*texture->w + tx];
+                src = { mul8(src.r, t.r), mul8(src.g, t.g),
+                    mul8(src.b, t.b), mul8(src.a, t.a) };
+            }
+
+            // src-over blending
+            Color &dst = row[x];
+            if (src.a == 255) {
+                dst = src;
+            } else if (src.a != 0) {
+                int inv = 255 - src.a;
+                dst = { Uint8(mul8(src.r, src.a) + mul8(dst.r, inv)),
+                    Uint8(mul8(src.g, src.a) + mul8(dst.g, inv)),
+                    Uint8(mul8(src.b, src.a) + mul8(dst.b, inv)),
+                    Uint8(src.a + mul8(dst.a, inv)) };
+            }
+        }
+    }
+}
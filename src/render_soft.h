@@ -0,0 +1,336 @@
+// render_soft.h - headless Renderer backend that rasterizes on the CPU into
+// an in-memory framebuffer. For benchmarks and golden-image tests; no window
+// or GPU needed
+
+#pragma once
+
+#include "bench.h"
+#include "pixelWriter.h"
+#include "render.h"
+#include "test.h"
+
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+struct Texture_Soft : public Texture {
+    std::vector<Color> pixels; // RGBA, row-major, no padding
+};
+
+/// @brief What a batch passed to the backend was drawing, for timing purposes
+enum PrimitiveKind {
+    primClear,
+    primShapes, // untextured rects, boxes, lines
+    primImages,
+    primText,
+    numPrimitiveKinds,
+};
+
+struct PrimitiveTiming {
+    int calls;
+    int triangles;
+    double ms;
+};
+
+class Renderer_Soft : public Renderer {
+    Vec2i _size;
+    std::vector<Color> _pixels; // persists between frames
+    // inclusive range of pixels we're allowed to touch
+    Vec2i _clipLo, _clipHi;
+
+    const Uint64 _freq = SDL_GetPerformanceFrequency();
+
+public:
+    // time spent rasterizing each kind of primitive, for the last presented
+    // frame and summed over all of them
+    PrimitiveTiming frameTiming[numPrimitiveKinds] = {};
+    PrimitiveTiming totalTiming[numPrimitiveKinds] = {};
+    int numFrames = 0;
+
+    Renderer_Soft(Vec2i size = screenSize.to<int>());
+    ~Renderer_Soft();
+
+    Vec2i size() const;
+    /// @brief The last presented frame, RGBA, row-major
+    const Color* pixels() const;
+    Color pixel(int x, int y) const;
+
+    /// @return false on failure
+    bool saveBMP(const char* filename) const;
+    /// @brief Compares the framebuffer against an image on disk, ignoring alpha
+    /// @param tolerance max per-channel difference for two pixels to match
+    /// @return number of mismatched pixels, or -1 if the image couldn't be
+    /// loaded or is a different size
+    int diffImage(const char* filename, int tolerance = 0) const;
+
+    /// @brief Logs average per-frame time for each primitive kind
+    void logTimings() const;
+
+    Uint32 pixelFormat() const override;
+
+protected:
+    Texture* allocTexture(int w, int h) override;
+    void uploadTexture(Texture* texture, SDL_Surface* surface) override;
+    void uploadTextureRegion(Texture* texture, SDL_Surface* surface,
+        Vec2i pos) override;
+    void freeTexture(Texture* texture) override;
+
+    void clear(Color color) override;
+    void setClip(const Rect* clip) override;
+    void drawGeometry(Texture* texture,
+        const Vertex* vertices, int numVertices,
+        const int* indices, int numIndices) override;
+    void present() override;
+
+private:
+    void drawTriangle(const Texture_Soft* texture,
+        const Vertex& a, const Vertex& b, const Vertex& c);
+    void record(PrimitiveKind kind, int triangles, Uint64 start);
+};
+
+BENCH(renderSoft, {
+    // a fixed, busy frame: lots of each primitive kind, with overlap
+    Renderer_Soft renderer;
+    SDL_Surface* checker = SDL_CreateRGBSurfaceWithFormat(0, 16, 16, 32,
+        SDL_PIXELFORMAT_RGBA32);
+    for (int i = 0; i < 16*16; ++i) {
+        bool odd = (i%16/4 + i/16/4) % 2;
+        ((Color*)checker->pixels)[i] = odd ? Color::white : Color {0x40, 0x80, 0xc0};
+    }
+    Texture* image = renderer.createTexture(checker);
+    SDL_FreeSurface(checker);
+
+    auto drawFrame = [&](const char* label) {
+        renderer.startFrame();
+        renderer.background(rgbColor(0.2, 0.2, 0.3));
+        for (int i = 0; i < 1000; ++i) {
+            float x = (i*37) % 1880;
+            float y = (i*91) % 1040;
+            renderer.setColor(hsvColor(i*7 % 360, 0.8, 0.9));
+            renderer.drawRect(x, y, 40, 40);
+            renderer.drawBox(x+10, y+10, 60, 30);
+            renderer.drawLine({x, y}, {x+80, y+25});
+        }
+        for (int i = 0; i < 200; ++i) {
+            renderer.drawImage(image, (i*53) % 1800, (i*29) % 1000, 64, 64);
+        }
+        for (int i = 0; i < 100; ++i) {
+            renderer.drawText("The quick brown fox jumps over the lazy dog",
+                (i*13) % 1500, i*10);
+        }
+        renderer.setColor(Color::black);
+        renderer.drawRect(8, 1060, 200, 12);
+        renderer.drawText(label, 10, 1062);
+        renderer.endFrame();
+    };
+
+    const int iters = 20;
+    BENCH_LOOP("full redraw", iters, {
+        renderer.invalidateAll();
+        drawFrame("frame");
+    });
+    renderer.logTimings();
+    BENCH_LOOP("unchanged frame", iters, {
+        drawFrame("frame");
+    });
+    char label[32];
+    BENCH_LOOP("one label changed", iters, {
+        snprintf(label, sizeof(label), "frame %d", _bench_i);
+        drawFrame(label);
+    });
+    auto stats = renderer.stats();
+    printf("  last frame redrew %d rects, %d pixels\n",
+        stats.damageRects, stats.redrawnPixels);
+    renderer.destroyTexture(image);
+})
+
+TEST(renderSoftGolden, {
+    // a small fixed frame with every primitive kind, overlapping across
+    // layers and textures, checked against data/renderSoft.golden.bmp. On a
+    // mismatch the frame is saved to out/renderSoft.actual.bmp; if the
+    // change is intended, copy that over the golden image
+    Renderer_Soft renderer({320, 180});
+    auto checker = [&](Color a, Color b) {
+        SDL_Surface* surf = SDL_CreateRGBSurfaceWithFormat(0, 16, 16, 32,
+            SDL_PIXELFORMAT_RGBA32);
+        for (int i = 0; i < 16*16; ++i) {
+            ((Color*)surf->pixels)[i] = (i%16/4 + i/16/4) % 2 ? a : b;
+        }
+        Texture* texture = renderer.createTexture(surf);
+        SDL_FreeSurface(surf);
+        return texture;
+    };
+    Texture* blue = checker(Color::white, {0x40, 0x80, 0xc0});
+    Texture* red = checker(Color::black, {0xc0, 0x40, 0x40});
+
+    auto drawFrame = [&](const char* label) {
+        renderer.startFrame();
+        renderer.background(rgbColor(0.2, 0.2, 0.3));
+        for (int i = 0; i < 40; ++i) {
+            float x = (i*37) % 290;
+            float y = (i*23) % 150;
+            renderer.setColor(hsvColor(i*29 % 360, 0.8, 0.9));
+            renderer.drawRect(x, y, 20, 20);
+            renderer.drawBox(x+5, y+5, 30, 15);
+            renderer.drawLine({x, y}, {x+40, y+12});
+        }
+        // overlapping images with alternating textures, which have to stay
+        // in the order they were drawn
+        for (int i = 0; i < 12; ++i) {
+            renderer.drawImage(i%2 ? red : blue, 20 + i*18, 40 + (i%3)*10,
+                32, 32);
+        }
+        int prevLayer = renderer.setLayer(layerUI);
+        renderer.setColor(Color::black);
+        renderer.drawRect(4, 150, 150, 24);
+        renderer.drawText("The quick brown fox", 6, 152);
+        renderer.drawText(label, 6, 164);
+        renderer.setLayer(prevLayer);
+        renderer.endFrame();
+    };
+    // through a full redraw, then damage tracking back to the same frame
+    drawFrame("golden");
+    drawFrame("changed label");
+    drawFrame("golden");
+
+    const char* golden = "../data/renderSoft.golden.bmp";
+    // a couple of edge pixels may round differently across compilers
+    int diff = renderer.diffImage(golden, 2);
+    if (diff != 0) {
+        renderer.saveBMP("renderSoft.actual.bmp");
+    }
+    TEST_EQ_MSG(diff < 0, false, "couldn't load ../data/renderSoft.golden.bmp");
+    TEST_EQ_MSG(diff <= 320*180/1000, true,
+        "frame differs from ../data/renderSoft.golden.bmp");
+    renderer.destroyTexture(blue);
+    renderer.destroyTexture(red);
+})
+
+TEST(textureManagerPinnedPage, {
+    // two small textures share an atlas page. Evicting the cached one while
+    // the other's still live would free nothing, so it has to stay until
+    // the whole page can go
+    Renderer_Soft renderer({64, 64});
+    TextureManager& textures = renderer.textures();
+    auto make = [&](Uint32 pixel) {
+        SDL_Surface* surf = renderer.createSurface(8, 8);
+        for (int i = 0; i < 8*8; ++i) {
+            ((Uint32*)surf->pixels)[i] = pixel;
+        }
+        TextureHandle handle = textures.create(surf, "test");
+        SDL_FreeSurface(surf);
+        return handle;
+    };
+    size_t fontBytes = textures.totalBytes();
+    TextureHandle live = make(0xff0000ff);
+    TextureHandle cached = make(0x00ff00ff);
+    TextureHandle cachedCopy = cached;
+    size_t withPage = textures.totalBytes();
+    TEST_EQ(withPage > fontBytes, true);
+    TEST_EQ(textures.get(live).texture, textures.get(cached).texture);
+    textures.release(cached);
+    // over budget by exactly the page
+    textures.setBudget(fontBytes);
+    for (int i = 0; i < 8; ++i) {
+        renderer.startFrame();
+        textures.get(live);
+        renderer.endFrame();
+    }
+    TEST_EQ(textures.totalBytes(), withPage);
+    TEST_EQ(textures.get(cachedCopy).texture != nullptr, true);
+
+    TextureHandle liveCopy = live;
+    textures.release(live);
+    for (int i = 0; i < 8; ++i) {
+        renderer.startFrame();
+        renderer.endFrame();
+    }
+    TEST_EQ(textures.totalBytes(), fontBytes);
+    TEST_EQ(textures.get(cachedCopy).texture == nullptr, true);
+    TEST_EQ(textures.get(liveCopy).texture == nullptr, true);
+})
+
+BENCH(renderThread, {
+    // a frame that changes everywhere, so every frame is a full redraw
+    Renderer_Soft renderer;
+    auto drawFrame = [&](int frame) {
+        renderer.startFrame();
+        renderer.background(Color::black);
+        for (int i = 0; i < 2000; ++i) {
+            renderer.setColor(hsvColor((i*7 + frame) % 360, 0.8, 0.9));
+            renderer.drawRect((i*37 + frame) % 1880, (i*91) % 1040, 40, 40);
+        }
+        renderer.endFrame();
+    };
+    // stands in for the game's update; spins rather than sleeps, like real work
+    auto update = [](double ms) {
+        Uint64 end = SDL_GetPerformanceCounter()
+            + Uint64(ms / 1000 * SDL_GetPerformanceFrequency());
+        while (SDL_GetPerformanceCounter() < end) {
+        }
+    };
+
+    const int iters = 30;
+    double renderMs;
+    {
+        BenchTimer timer("render only", iters);
+        for (int i = 0; i < iters; ++i) {
+            drawFrame(i);
+        }
+        renderMs = timer.elapsedUs() / 1000 / iters;
+    }
+    // updates as slow as rendering is the best case for overlapping them
+    BENCH_LOOP("update + render, one thread", iters, {
+        update(renderMs);
+        drawFrame(_bench_i);
+    });
+    renderer.startRenderThread();
+    BENCH_LOOP("update + render, render thread", iters, {
+        update(renderMs);
+        drawFrame(_bench_i);
+    });
+    renderer.stopRenderThread();
+})
+
+BENCH(textureUpload, {
+    // what TexGen and EyeGen used to do: hand-written masks with no alpha,
+    // writing through Color, which the backend then converts
+    Renderer_Soft renderer;
+    const int size = 256;
+    SDL_Surface* masked = SDL_CreateRGBSurface(0, size, size, 32,
+        0xff, 0xff << 8, 0xff << 16, 0);
+    SDL_Surface* native = renderer.createSurface(size, size);
+    PixelWriter pixels(native, true);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            Color c = hsvColor(x + y, 0.8, 0.9);
+            *(Color*)((Uint8*)masked->pixels + y*masked->pitch + x*4) = c;
+            pixels.set(x, y, c);
+        }
+    }
+    Texture* texture = renderer.createTexture(native);
+
+    const int iters = 500;
+    BENCH_LOOP("upload, converted", iters, {
+        renderer.updateTexture(texture, masked, {0, 0});
+    });
+    BENCH_LOOP("upload, native format", iters, {
+        renderer.updateTexture(texture, native, {0, 0});
+    });
+    // both paths should land on the same pixels
+    renderer.startFrame();
+    renderer.drawImage(texture, 0, 0, size, size);
+    renderer.endFrame();
+    Color a = renderer.pixel(10, 20);
+    renderer.updateTexture(texture, masked, {0, 0});
+    renderer.startFrame();
+    renderer.drawImage(texture, 0, 0, size, size);
+    renderer.endFrame();
+    Color b = renderer.pixel(10, 20);
+    check(a.r == b.r && a.g == b.g && a.b == b.b,
+        "native upload differs: %d,%d,%d vs %d,%d,%d", a.r, a.g, a.b, b.r, b.g, b.b);
+
+    renderer.destroyTexture(texture);
+    SDL_FreeSurface(masked);
+    SDL_FreeSurface(native);
+})
@@ -4,8 +4,9 @@
 
 #include "common.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "scene.h"
+#include "serialize.h"
 #include "ui.h"
 #include "vec.h"
 
@@ -22,6 +23,19 @@ struct Fighter {
     float action;
 };
 
+// not `name`, which points into whichever dll set it
+template <>
+struct SerialFields<Fighter> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("hp", &Fighter::hp),
+        serialField("maxHp", &Fighter::maxHp),
+        serialField("attack", &Fighter::attack),
+        serialField("defense", &Fighter::defense),
+        serialField("speed", &Fighter::speed),
+        serialField("action", &Fighter::action));
+};
+
 class RpgScene : public Scene {
     Allocator* _allocator;
     Input* _input;
@@ -41,6 +55,14 @@ public:
         _ui.unload();
     }
 
+    Uint32 saveState(BinaryWriter &out) const override {
+        return writeRecord(out, *this);
+    }
+    void loadState(const BinaryRecord &record) override {
+        // over the fresh battle the constructor started, so names are kept
+        readRecord(record, *this);
+    }
+
     void update(float dt) override {
         _ui.startUpdate();
 
@@ -92,4 +114,16 @@ public:
     }
 
     void uiCursor() {}
+
+private:
+    friend struct SerialFields<RpgScene>;
+};
+
+template <>
+struct SerialFields<RpgScene> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("player", &RpgScene::_player),
+        serialField("enemy", &RpgScene::_enemy),
+        serialField("xp", &RpgScene::_xp));
 };
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "render_sdl.h"
+#include "render.h"
+#include "serialize.h"
 
 /// @brief abstract base class for
 class Scene {
@@ -10,6 +11,22 @@ public:
     virtual void onLoad() {}
     virtual void onUnload() {}
 
+    /// @brief Saves what should survive a reload, e.g. whatever's mid-
+    /// simulation, so the reloaded scene picks up where this one left off.
+    /// Scenes with SerialFields can just `return writeRecord(out, *this)`
+    /// @return the offset of the record written, or 0 if there's nothing
+    virtual Uint32 saveState(BinaryWriter &out) const { return 0; }
+    /// @brief Restores what the last dll's `saveState` saved. Called right
+    /// after the scene's constructed, before `onLoad`, so that can tell
+    /// whether it's starting fresh
+    virtual void loadState(const BinaryRecord &record) {}
+
     virtual void update(float dt) = 0;
     virtual void render(Renderer* renderer) = 0;
+
+    /// @brief How far between the last two updates we're rendering, in [0, 1].
+    /// Set right before each `render`; scenes with things in motion can use
+    /// it to interpolate positions, so they don't stutter when the render
+    /// rate doesn't line up with the fixed update rate
+    float renderAlpha = 1.0f;
 };
@@ -3,9 +3,16 @@
 #include "builder.h"
 #include "common.h"
 #include "dylib.h"
+#include "fileWatcher.h"
+#include "frameScheduler.h"
+#include "inputLog.h"
+#include "reloadState.h"
+#include "render_sdl.h"
+#include "render_soft.h"
 
 #include <math.h>
 #include <map>
+#include <string.h>
 #include <vector>
 
 #include <SDL2/SDL.h>
@@ -13,6 +20,45 @@
 
 
 int main(int argc, char** argv) {
+    // --headless draws with the software renderer into an offscreen buffer,
+    // with no window, e.g. for benchmarking; --frames N quits after N frames;
+    // --no-render-thread draws on the main thread, after each update;
+    // --texture-budget MB sets how much texture memory to keep cached;
+    // --record FILE saves the session's input, and --replay FILE plays it
+    // back as fast as it'll go; --no-render skips drawing, e.g. to replay
+    // faster than real time; --rebuild rebuilds game.dll in the background
+    // when its sources change, instead of `build.py watch`
+    bool headless = false;
+    bool renderThread = true;
+    bool render = true;
+    bool rebuild = false;
+    int maxFrames = 0;
+    int textureBudgetMB = 0;
+    const char* recordFile = nullptr;
+    const char* replayFile = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--no-render-thread") == 0) {
+            renderThread = false;
+        } else if (strcmp(argv[i], "--frames") == 0 && i+1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--texture-budget") == 0 && i+1 < argc) {
+            textureBudgetMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+            recordFile = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+            replayFile = argv[++i];
+        } else if (strcmp(argv[i], "--no-render") == 0) {
+            render = false;
+        } else if (strcmp(argv[i], "--rebuild") == 0) {
+            rebuild = true;
+        }
+    }
+    if (headless) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+
     log("Loading SDL...");
     assert_SDL(SDL_Init(SDL_INIT_EVERYTHING) >= 0, "sdl_init failed");
     auto imgFlags = IMG_INIT_PNG;
@@ -21,38 +67,185 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
-    Builder builder; // TODO: refactor Builder and remove unused code
+#ifdef _WIN32
     const char* dllName = "game.dll";
+#else
+    const char* dllName = "game.so";
+#endif
+    // shared by the reload check here and by game.dll's assets
+    FileWatcher fileWatcher;
+    Builder builder(&fileWatcher, dllName); // TODO: refactor Builder and remove unused code
+    // needs to exist before we create the renderer, for vsync. Replays
+    // don't wait on anything; frame times come from the log
+    FrameScheduler scheduler = replayFile
+        ? FrameScheduler(pacingUncapped)
+        : FrameScheduler::fromArgs(argc, argv);
+
+    InputLog inputLog;
+    if (replayFile) {
+        if (!inputLog.startReplay(replayFile)) {
+            exit(1);
+        }
+    } else if (recordFile) {
+        inputLog.startRecording(recordFile);
+    }
+
+    // the renderer lives here rather than in game.dll so its vtable stays
+    // valid across reloads; see doc/rendering.md
+    SDL_Window* window = nullptr;
+    Renderer_Soft* softRenderer = nullptr;
+    Renderer* renderer;
+    if (headless) {
+        softRenderer = new Renderer_Soft();
+        renderer = softRenderer;
+    } else {
+        window = SDL_CreateWindow(
+            "I Heard You Liked Video Games",
+            SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+            screenSize.x, screenSize.y,
+            SDL_WINDOW_SHOWN);
+        assert_SDL(window, "window creation failed");
+
+        SDL_Surface* screen = SDL_GetWindowSurface(window);
+        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0xff, 0xff, 0xff));
+        SDL_UpdateWindowSurface(window);
+
+        // starts its own render thread, if asked, since the SDL_Renderer has
+        // to be created on whichever thread will use it
+        renderer = new Renderer_SDL(window, renderThread);
+    }
+    if (textureBudgetMB > 0) {
+        renderer->textures().setBudget(size_t(textureBudgetMB) << 20);
+    }
+    // the main thread records frame N+1 while the render thread draws
+    // frame N, so a frame costs max(update, render) rather than the sum
+    if (renderThread && renderer->startRenderThread()) {
+        scheduler.presentingOffThread();
+    }
+
     GameDylib dll(dllName);
 
     log("setup complete");
 
     Allocator allocator { malloc, calloc, free };
-    void* game = dll.newGame(&allocator);
+    // the game snapshots its scenes into this across reloads
+    ReloadState reloadState(&allocator);
+    void* game = dll.newGame(&allocator, renderer, &inputLog, &reloadState,
+        &fileWatcher);
     dll.onLoad(game);
 
+    // the simulation always advances in fixed steps of `dt`; real elapsed time
+    // accumulates and gets consumed a step at a time, so sim speed doesn't
+    // depend on how long frames take
+    const float dt = 0.01;
+    // if a frame would need more steps than this to catch up, we drop the
+    // backlog instead; otherwise slow steps put us further behind each frame
+    const int maxStepsPerFrame = 5;
+    const Uint64 perfFreq = SDL_GetPerformanceFrequency();
+    Uint64 lastTime = SDL_GetPerformanceCounter();
+    float accumulator = 0;
+    int numFrames = 0;
+    scheduler.restart();
+
+    // reload latency, from the new build's link finishing to the first
+    // frame with its code; see logReloadLatency
+    struct {
+        bool pending = false;
+        double noticedAt;
+        double swapMs;
+        int count = 0;
+        double totalMs = 0;
+    } reload;
+    auto logReloadLatency = [&]() {
+        double builtAt = dll.builtAt();
+        double latencyMs = 1000 * (GameDylib::wallClock() - builtAt);
+        reload.count++;
+        reload.totalMs += latencyMs;
+        log("reloaded %s: %.1fms from link to first frame (noticed after "
+            "%.1fms, swap took %.1fms)", dllName, latencyMs,
+            1000 * (reload.noticedAt - builtAt), reload.swapMs);
+        reload.pending = false;
+    };
+
     // Main game loop
-    while (!dll.shouldQuit(game)) {
-        // reload dll if it changes
-        if (builder.shouldReload()) {
+    while (!dll.shouldQuit(game) && (maxFrames == 0 || numFrames < maxFrames)
+            && !inputLog.finished()) {
+        // reload dll if it changes. Here at the top of the frame, so each
+        // frame runs on one version of the code
+        fileWatcher.poll();
+        if (rebuild) {
+            builder.update();
+        }
+        if (builder.shouldReload() && dll.changedOnDisk()) {
+            reload.noticedAt = GameDylib::wallClock();
+            Uint64 start = SDL_GetPerformanceCounter();
             dll.onUnload(game);
             dll.reload();
             dll.onLoad(game);
+            reload.swapMs = 1000.0 * (SDL_GetPerformanceCounter() - start)
+                / perfFreq;
+            reload.pending = true;
+            // time spent reloading shouldn't count as simulation time
+            lastTime = SDL_GetPerformanceCounter();
         }
 
+        Uint64 now = SDL_GetPerformanceCounter();
+        accumulator += inputLog.frameTime(float(now - lastTime) / perfFreq);
+        lastTime = now;
+
+        // input and UI once per frame, however many steps it takes
+        dll.startFrame(game);
+
         // Update logic
-        float dt = 0.01;
-        dll.update(game, dt);
+        int steps = 0;
+        while (accumulator >= dt && steps < maxStepsPerFrame
+                && !dll.shouldQuit(game)) {
+            dll.update(game, dt);
+            accumulator -= dt;
+            steps++;
+        }
+        if (accumulator >= dt) {
+            log("dropping %.1fms of simulation time", 1000*(accumulator-fmod(accumulator, dt)));
+            accumulator = fmod(accumulator, dt);
+        }
 
-        dll.renderScene(game);
+        // render partway between the last step and the next one
+        float alpha = accumulator / dt;
+        if (render) {
+            dll.renderScene(game, alpha);
+        }
+        if (reload.pending) {
+            logReloadLatency();
+        }
 
         // End-of-frame bookkeeping
         fflush(stdout);
-        SDL_Delay(10);
+        scheduler.endFrame();
+        numFrames++;
     }
 
+    // the game's shutdown frees textures, which is simpler with nothing in flight
+    renderer->stopRenderThread();
+    renderer->logLatencyReport();
+    if (reload.count > 0) {
+        log("%d reloads, %.1fms from link to first frame on average",
+            reload.count, reload.totalMs / reload.count);
+    }
+    inputLog.close();
+    inputLog.logReport();
+    scheduler.logReport();
+    renderer->textures().logReport();
+    if (softRenderer) {
+        softRenderer->logTimings();
+    }
     dll.freeGame(game, &allocator);
 
+    // the game may still have textures to destroy, so this has to come after
+    delete renderer;
+    if (window) {
+        SDL_DestroyWindow(window);
+    }
+
     SDL_Quit();
 
     log("everything went better than expected");
@@ -0,0 +1,283 @@
+#include "serialize.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static Uint32 alignUp(size_t size) {
+    return (size + binaryAlign-1) & ~(binaryAlign-1);
+}
+
+BinaryWriter::BinaryWriter(Uint32 version) {
+    BinaryHeader header {{}, binaryFormatVersion, version, 0};
+    memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    _data.resize(sizeof(header));
+    memcpy(_data.data(), &header, sizeof(header));
+}
+
+void BinaryWriter::reserve(size_t bytes) {
+    _data.reserve(bytes);
+}
+
+Uint32 BinaryWriter::startRecord(int numFields, Uint32 version) {
+    BinaryRecordHeader header {Uint32(numFields), version};
+    Uint32 record = alignUp(_data.size());
+    _data.resize(record + sizeof(header) + numFields*sizeof(BinaryField));
+    memcpy(&_data[record], &header, sizeof(header));
+    return record;
+}
+
+void BinaryWriter::setField(Uint32 record, int index, BinaryField field) {
+    size_t offset = record + sizeof(BinaryRecordHeader)
+        + index*sizeof(BinaryField);
+    patch(offset, &field, sizeof(field));
+}
+
+void BinaryWriter::setRoot(Uint32 record) {
+    memcpy(&_data[offsetof(BinaryHeader, root)], &record, sizeof(record));
+}
+
+BinaryField BinaryWriter::append(BinaryKind kind, const void* data,
+        Uint32 size, Uint32 count, Uint32 elemSize) {
+    Uint32 offset = alignUp(_data.size());
+    _data.resize(offset + size);
+    if (data && size > 0) {
+        memcpy(&_data[offset], data, size);
+    }
+    return {0, kind, offset, size, count, elemSize};
+}
+
+void BinaryWriter::patch(Uint32 offset, const void* data, Uint32 size) {
+    memcpy(&_data[offset], data, size);
+}
+
+const std::vector<Uint8>& BinaryWriter::data() const {
+    return _data;
+}
+
+bool BinaryWriter::saveToFile(const char* filename) const {
+    FILE* file = fopen(filename, "wb");
+    if (!check(file, "could not open file: %s", filename)) {
+        return false;
+    }
+    size_t written = fwrite(_data.data(), 1, _data.size(), file);
+    fclose(file);
+    return check(written == _data.size(), "could not write all of %s",
+        filename);
+}
+
+BinaryRecord::BinaryRecord(const Uint8* file, size_t fileSize,
+        Uint32 offset) {
+    if (offset % binaryAlign != 0
+            || Uint64(offset) + sizeof(BinaryRecordHeader) > fileSize) {
+        return;
+    }
+    BinaryRecordHeader header;
+    memcpy(&header, file + offset, sizeof(header));
+    Uint64 end = Uint64(offset) + sizeof(header)
+        + Uint64(header.numFields)*sizeof(BinaryField);
+    if (end > fileSize) {
+        return;
+    }
+    _file = file;
+    _fileSize = fileSize;
+    _fields = (const BinaryField*)(file + offset + sizeof(header));
+    _numFields = header.numFields;
+    _version = header.version;
+}
+
+bool BinaryRecord::valid() const {
+    return _file != nullptr;
+}
+
+Uint32 BinaryRecord::version() const {
+    return _version;
+}
+
+int BinaryRecord::numFields() const {
+    return _numFields;
+}
+
+const BinaryField& BinaryRecord::field(int index) const {
+    return _fields[index];
+}
+
+const BinaryField* BinaryRecord::find(Uint32 id, int hint) const {
+    if (hint < _numFields && _fields[hint].id == id) {
+        return &_fields[hint];
+    }
+    // records are small; a scan beats anything fancier
+    for (int i = 0; i < _numFields; ++i) {
+        if (_fields[i].id == id) {
+            return &_fields[i];
+        }
+    }
+    return nullptr;
+}
+
+BinaryRecord BinaryRecord::record(const BinaryField &field) const {
+    if (field.kind != binaryRecord) {
+        return {};
+    }
+    return BinaryRecord(_file, _fileSize, field.offset);
+}
+
+BinaryRecord BinaryRecord::recordAt(Uint32 offset) const {
+    return BinaryRecord(_file, _fileSize, offset);
+}
+
+bool BinaryRecord::contains(const BinaryField &field) const {
+    return field.offset % binaryAlign == 0
+        && Uint64(field.offset) + field.size <= _fileSize;
+}
+
+BinaryFile::~BinaryFile() {
+    close();
+}
+
+bool BinaryFile::open(const char* filename) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (!check(file != INVALID_HANDLE_VALUE, "could not open file: %s",
+            filename)) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    // the view keeps the mapping alive, and the mapping the file
+    HANDLE mapping = size.QuadPart > 0
+        ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+        : nullptr;
+    CloseHandle(file);
+    if (mapping) {
+        _data = (const Uint8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    _size = size.QuadPart;
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (!check(fd >= 0, "could not open file: %s", filename)) {
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    void* data = info.st_size > 0
+        ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    _data = data == MAP_FAILED ? nullptr : (const Uint8*)data;
+    _size = info.st_size;
+#endif
+    if (!check(_data, "could not map %s", filename)) {
+        _size = 0;
+        return false;
+    }
+    _mapped = true;
+    return check(validate(), "%s isn't a valid binary file", filename);
+}
+
+bool BinaryFile::open(const void* data, size_t size) {
+    close();
+    _data = (const Uint8*)data;
+    _size = size;
+    return validate();
+}
+
+void BinaryFile::close() {
+    if (_mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        munmap((void*)_data, _size);
+#endif
+    }
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+}
+
+Uint32 BinaryFile::version() const {
+    BinaryHeader header;
+    memcpy(&header, _data, sizeof(header));
+    return header.version;
+}
+
+BinaryRecord BinaryFile::root() const {
+    if (!_data) {
+        return {};
+    }
+    BinaryHeader header;
+    memcpy(&header, _data, sizeof(header));
+    return BinaryRecord(_data, _size, header.root);
+}
+
+// checks everything `record` points at is in the file, nested records
+// included. `budget` caps how many records get visited, so a file whose
+// records point back at each other can't keep us here forever
+static bool validRecord(const BinaryRecord& record, int depth, int& budget) {
+    if (!record.valid() || depth > 64 || --budget < 0) {
+        return false;
+    }
+    for (int i = 0; i < record.numFields(); ++i) {
+        const BinaryField& field = record.field(i);
+        if (!record.contains(field)) {
+            return false;
+        }
+        if (field.kind == binaryRecord) {
+            if (!validRecord(record.record(field), depth+1, budget)) {
+                return false;
+            }
+        } else if (field.kind == binaryRecords) {
+            const Uint32* offsets = record.values<Uint32>(field);
+            if (!offsets) {
+                return false;
+            }
+            for (Uint32 j = 0; j < field.count; ++j) {
+                if (!validRecord(record.recordAt(offsets[j]), depth+1,
+                        budget)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool BinaryFile::validate() {
+    BinaryHeader header;
+    if (!_data || _size < sizeof(header)) {
+        close();
+        return false;
+    }
+    memcpy(&header, _data, sizeof(header));
+    bool valid = memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) == 0
+        && header.formatVersion == binaryFormatVersion
+        && header.root != 0;
+    // everything reachable from the root has to be in the file, so nothing
+    // reading it later needs to check; a record is at least a header, so
+    // there can't be more of them than that
+    int budget = _size / sizeof(BinaryRecordHeader);
+    valid = valid && validRecord(root(), 0, budget);
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+bool isBinaryFile(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(binaryMagic)] = {};
+    fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return memcmp(magic, binaryMagic, sizeof(binaryMagic)) == 0;
+}
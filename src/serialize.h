@@ -3,83 +3,440 @@
 #include "common.h"
 #include "test.h"
 
-#include <functional>
 #include <fstream>
+#include <sstream>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-template <typename T>
-class Serialize {
-    struct Field {
-        const char* name;
-
-        std::function<void (std::istream&)> read;
-        std::function<void (std::ostream&)> write;
-    };
-    std::vector<Field> fields;
+/// @brief 32-bit FNV-1a of a field's name; binary files know fields by it
+constexpr Uint32 fieldId(const char* name) {
+    Uint32 hash = 2166136261u;
+    for (; *name; ++name) {
+        hash = (hash ^ Uint8(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+// The binary format: a BinaryHeader, then records. A record is a table of
+// BinaryFields, each pointing at its data elsewhere in the file. Data always
+// starts on a multiple of `binaryAlign`, so a mapped file's arrays can be
+// read in place. Fields are looked up by id, so adding, removing or
+// reordering them doesn't break old files; anything a file doesn't have
+// keeps its default
+const char binaryMagic[4] = {'S', 'C', 'Y', 'B'};
+const Uint32 binaryFormatVersion = 1;
+const Uint32 binaryAlign = 8;
+
+enum BinaryKind : Uint32 {
+    binaryValue, // one trivially copyable value, as is
+    binaryArray, // `count` trivially copyable values
+    binaryRecord, // a nested record
+    binaryRecords, // `count` nested records; the data is their offsets
+};
+
+struct BinaryHeader {
+    char magic[4];
+    Uint32 formatVersion; // of the container, i.e. `binaryFormatVersion`
+    Uint32 version; // of the saved type; see SerialFields
+    Uint32 root; // offset of the top-level record
+};
+
+struct BinaryField {
+    Uint32 id; // fieldId of its name
+    Uint32 kind; // a BinaryKind
+    Uint32 offset; // from the start of the file
+    Uint32 size; // in bytes
+    Uint32 count; // of elements, for arrays; otherwise 1
+    Uint32 elemSize; // so a type that's changed size fails to load, rather
+                     // than loading garbage
+};
+
+// a record starts with this, followed by `numFields` BinaryFields
+struct BinaryRecordHeader {
+    Uint32 numFields;
+    Uint32 version; // of the type it was saved from
+};
+
+/// @brief Builds a binary file in memory
+class BinaryWriter {
+    std::vector<Uint8> _data;
+
 public:
-    Serialize(T &item) {}
-
-    template <typename V>
-    void addField(const char* name, V &field) {
-        auto read = [&](std::istream &is) {
-            is >> field;
-        };
-        auto write = [&](std::ostream &os) {
-            os << field << ' ';
-        };
-        fields.push_back({name, read, write});
+    /// @param version of the type being saved
+    BinaryWriter(Uint32 version);
+
+    /// @brief Makes room for `bytes` in all, e.g. as much as last time, so
+    /// writing doesn't have to keep growing the buffer
+    void reserve(size_t bytes);
+
+    /// @brief Reserves a record's field table
+    /// @param version of the type it's saved from
+    /// @return its offset, to fill in with `setField`
+    Uint32 startRecord(int numFields, Uint32 version);
+    void setField(Uint32 record, int index, BinaryField field);
+    void setRoot(Uint32 record);
+
+    /// @brief Appends `size` bytes, aligned to `binaryAlign`
+    /// @param data null to leave them zeroed, e.g. to `patch` in later
+    /// @return a field pointing at them, with no id yet
+    BinaryField append(BinaryKind kind, const void* data, Uint32 size,
+        Uint32 count, Uint32 elemSize);
+    /// @brief Overwrites bytes already appended
+    void patch(Uint32 offset, const void* data, Uint32 size);
+
+    const std::vector<Uint8>& data() const;
+    bool saveToFile(const char* filename) const;
+};
+
+/// @brief A view of one record in a binary file. Only valid as long as the
+/// BinaryFile it came from
+class BinaryRecord {
+    const Uint8* _file = nullptr;
+    size_t _fileSize = 0;
+    const BinaryField* _fields = nullptr;
+    int _numFields = 0;
+    Uint32 _version = 0;
+
+public:
+    BinaryRecord() {}
+    /// @brief The record at `offset`, or an empty one if it doesn't fit
+    BinaryRecord(const Uint8* file, size_t fileSize, Uint32 offset);
+
+    /// @brief Whether there was a record where it was supposed to be
+    bool valid() const;
+    Uint32 version() const;
+    int numFields() const;
+    const BinaryField& field(int index) const;
+    /// @param hint where to look first; fields are usually saved in the
+    /// order they're loaded, so that's almost always where it is
+    /// @return the field with the given id, or nullptr if there isn't one
+    const BinaryField* find(Uint32 id, int hint = 0) const;
+    /// @brief Whether all of a field's data is inside the file
+    bool contains(const BinaryField &field) const;
+
+    /// @brief Points at a field's values inside the file, without copying
+    /// @return nullptr if the field isn't `count` values of exactly T
+    template <typename T>
+    const T* values(const BinaryField &field) const {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "only trivially copyable types can be read in place");
+        static_assert(alignof(T) <= binaryAlign,
+            "type is more aligned than binary files guarantee");
+        if (field.kind == binaryRecord || field.elemSize != sizeof(T)
+                || field.size != Uint64(field.count) * sizeof(T)
+                || !contains(field)) {
+            return nullptr;
+        }
+        return (const T*)(_file + field.offset);
+    }
+    /// @brief Shorthand for looking up an array field by name
+    /// @param count set to the number of elements, 0 if it's missing
+    template <typename T>
+    const T* array(const char* name, int* count) const {
+        const BinaryField* field = find(fieldId(name));
+        const T* data = field ? values<T>(*field) : nullptr;
+        *count = data ? field->count : 0;
+        return data;
     }
-    // SFINAE
-    // template <typename V>
-    // void addField(const char* name, V &field) {
-    //     auto read = [&](std::istream &is) {
-    //         serialize(field).read(is);
-    //     };
-    //     auto write = [&](std::ostream &os) {
-    //         serialize(field).write(os);
-    //     };
-    //     fields.emplace_back(name, read, write);
-    // }
-
-    void read(std::istream &in) {
-        for (auto &field : fields) {
-            field.read(in);
+
+    /// @brief The record a binaryRecord field points at
+    BinaryRecord record(const BinaryField &field) const;
+    /// @brief Another record in the same file, e.g. from a binaryRecords
+    /// field's offsets
+    BinaryRecord recordAt(Uint32 offset) const;
+};
+
+/// @brief A binary file, mapped into memory rather than read, so opening
+/// one costs about the same however big it is, and arrays in it can be used
+/// in place
+class BinaryFile {
+    const Uint8* _data = nullptr;
+    size_t _size = 0;
+    bool _mapped = false; // otherwise, the caller owns `_data`
+
+public:
+    BinaryFile() {}
+    ~BinaryFile();
+    BinaryFile(const BinaryFile&) = delete;
+    BinaryFile& operator=(const BinaryFile&) = delete;
+
+    /// @return false if it couldn't be opened, or isn't a binary file
+    bool open(const char* filename);
+    /// @brief Reads from memory that's already loaded, which has to stay
+    /// valid for as long as this does
+    /// @return false if it isn't a binary file
+    bool open(const void* data, size_t size);
+    void close();
+
+    /// @brief The saved type's version, from its SerialFields
+    Uint32 version() const;
+    BinaryRecord root() const;
+
+private:
+    bool validate();
+};
+
+/// @brief Whether a file starts like a binary file, i.e. isn't text
+bool isBinaryFile(const char* filename);
+
+/// @brief Lists a type's fields, so it can be saved and loaded with no code
+/// of its own. Specialize it with a `version` and a tuple of `serialField`s:
+///
+///     template <>
+///     struct SerialFields<Foo> {
+///         static constexpr Uint32 version = 1;
+///         static constexpr auto fields = std::make_tuple(
+///             serialField("bar", &Foo::bar),
+///             serialField("baz", &Foo::baz));
+///     };
+///
+/// Text saves fields in that order; binary saves them by name, so adding,
+/// removing or reordering them is fine. Bump `version` when a field's
+/// meaning changes; files saved by a newer version won't load
+template <typename T>
+struct SerialFields {};
+
+template <typename T, typename V>
+struct SerialField {
+    const char* name;
+    Uint32 id;
+    V T::*member;
+};
+template <typename T, typename V>
+constexpr SerialField<T, V> serialField(const char* name, V T::*member) {
+    return {name, fieldId(name), member};
+}
+
+template <typename T, typename = void>
+struct HasSerialFields : std::false_type {};
+template <typename T>
+struct HasSerialFields<T, std::void_t<decltype(SerialFields<T>::fields)>>
+    : std::true_type {};
+
+template <typename T>
+struct IsVector : std::false_type {};
+template <typename E>
+struct IsVector<std::vector<E>> : std::true_type {};
+
+template <typename T, typename Fn, size_t ...I>
+void forEachField(Fn &fn, std::index_sequence<I...>) {
+    (fn(std::get<I>(SerialFields<T>::fields)), ...);
+}
+/// @brief Calls `fn` on each of T's SerialFields in turn. The list's a
+/// compile-time constant, so this unrolls into straight-line code
+template <typename T, typename Fn>
+void forEachField(Fn &&fn) {
+    using Fields = std::remove_const_t<decltype(SerialFields<T>::fields)>;
+    forEachField<T>(fn,
+        std::make_index_sequence<std::tuple_size<Fields>::value>());
+}
+
+// Text: fields are whitespace-separated, in order. Types with SerialFields
+// recurse into them, vectors are a count then each element, and anything
+// else goes through its stream operators
+
+template <typename V>
+void writeText(std::ostream &out, const V &value) {
+    if constexpr (HasSerialFields<V>::value) {
+        forEachField<V>([&](const auto &field) {
+            writeText(out, value.*field.member);
+        });
+    } else if constexpr (IsVector<V>::value) {
+        out << value.size() << ' ';
+        for (auto &elem : value) {
+            writeText(out, elem);
         }
+    } else if constexpr (std::is_integral<V>::value && sizeof(V) == 1) {
+        // as a number, not a character
+        out << int(value) << ' ';
+    } else {
+        out << value << ' ';
     }
-    void write(std::ostream &out) {
-        for (auto &field : fields) {
-            field.write(out);
+}
+
+template <typename V>
+void readText(std::istream &in, V &value) {
+    if constexpr (HasSerialFields<V>::value) {
+        forEachField<V>([&](const auto &field) {
+            readText(in, value.*field.member);
+        });
+    } else if constexpr (IsVector<V>::value) {
+        int count = 0;
+        in >> count;
+        value.resize(max(count, 0));
+        for (auto &elem : value) {
+            readText(in, elem);
         }
+    } else if constexpr (std::is_integral<V>::value && sizeof(V) == 1) {
+        int num = 0;
+        in >> num;
+        value = V(num);
+    } else {
+        in >> value;
     }
-};
+}
+
+// Binary: trivially copyable values are saved as is, and vectors of them as
+// arrays, which can be read in place. Types with SerialFields become nested
+// records, and vectors of them a list of records
+
+template <typename T>
+Uint32 writeRecord(BinaryWriter &out, const T &item);
+template <typename T>
+bool readRecord(const BinaryRecord &record, T &item);
+
+/// @brief Types that list their SerialFields save exactly those, even if
+/// they could be copied as-is, so they can leave out pointers and the like,
+/// and load by name if the members get reordered
+template <typename V>
+constexpr bool isBinaryValue = std::is_trivially_copyable<V>::value
+    && !HasSerialFields<V>::value;
+
+/// @return a field with no id yet
+template <typename V>
+BinaryField writeBinary(BinaryWriter &out, const V &value) {
+    if constexpr (isBinaryValue<V>) {
+        return out.append(binaryValue, &value, sizeof(V), 1, sizeof(V));
+    } else if constexpr (IsVector<V>::value) {
+        using E = typename V::value_type;
+        // copied whole, so the array can be used in place
+        if constexpr (isBinaryValue<E>) {
+            return out.append(binaryArray, value.data(),
+                value.size() * sizeof(E), value.size(), sizeof(E));
+        } else {
+            BinaryField field = out.append(binaryRecords, nullptr,
+                value.size() * sizeof(Uint32), value.size(), sizeof(Uint32));
+            for (int i = 0; i < value.size(); ++i) {
+                Uint32 record = writeRecord(out, value[i]);
+                out.patch(field.offset + i*sizeof(Uint32), &record,
+                    sizeof(record));
+            }
+            return field;
+        }
+    } else {
+        static_assert(HasSerialFields<V>::value,
+            "type needs SerialFields to be saved");
+        Uint32 record = writeRecord(out, value);
+        constexpr Uint32 numFields = std::tuple_size<
+            std::remove_const_t<decltype(SerialFields<V>::fields)>>::value;
+        return {0, binaryRecord, record,
+            sizeof(BinaryRecordHeader) + numFields*sizeof(BinaryField),
+            1, 0};
+    }
+}
 
+/// @return false if the field isn't the shape `value` expects
+template <typename V>
+bool readBinary(const BinaryRecord &record, const BinaryField &field,
+        V &value) {
+    if constexpr (isBinaryValue<V>) {
+        const V* data = record.values<V>(field);
+        if (!data || field.kind != binaryValue) {
+            return false;
+        }
+        memcpy(&value, data, sizeof(V));
+        return true;
+    } else if constexpr (IsVector<V>::value) {
+        using E = typename V::value_type;
+        if constexpr (isBinaryValue<E>) {
+            const E* data = record.values<E>(field);
+            if (!data || field.kind != binaryArray) {
+                return false;
+            }
+            value.assign(data, data + field.count);
+            return true;
+        } else {
+            const Uint32* offsets = record.values<Uint32>(field);
+            if (!offsets || field.kind != binaryRecords) {
+                return false;
+            }
+            value.resize(field.count);
+            bool ok = true;
+            for (int i = 0; i < field.count; ++i) {
+                ok &= readRecord(record.recordAt(offsets[i]), value[i]);
+            }
+            return ok;
+        }
+    } else {
+        return readRecord(record.record(field), value);
+    }
+}
+
+/// @return the offset of the record written
 template <typename T>
-std::istream& operator>>(std::istream &in, Serialize<T> &serial) {
-    serial.read(in);
-    return in;
+Uint32 writeRecord(BinaryWriter &out, const T &item) {
+    constexpr int numFields = std::tuple_size<
+        std::remove_const_t<decltype(SerialFields<T>::fields)>>::value;
+    Uint32 record = out.startRecord(numFields, SerialFields<T>::version);
+    int index = 0;
+    forEachField<T>([&](const auto &field) {
+        BinaryField entry = writeBinary(out, item.*field.member);
+        entry.id = field.id;
+        out.setField(record, index++, entry);
+    });
+    return record;
 }
+
+/// @brief Reads every field the record has, leaving the rest as they are
+/// @return false if it's from a newer version, or any field was there but
+/// the wrong shape
 template <typename T>
-std::ostream& operator<<(std::ostream &out, Serialize<T> &serial) {
-    serial.write(out);
-    return out;
+bool readRecord(const BinaryRecord &record, T &item) {
+    if (!record.valid()) {
+        return false;
+    }
+    if (!check(record.version() <= SerialFields<T>::version,
+            "saved by a newer version (%d, we're at %d)",
+            record.version(), SerialFields<T>::version)) {
+        return false;
+    }
+    bool ok = true;
+    int index = 0;
+    forEachField<T>([&](const auto &field) {
+        const BinaryField* entry = record.find(field.id, index++);
+        if (entry && !readBinary(record, *entry, item.*field.member)) {
+            check(false, "field \"%s\" doesn't match its saved type",
+                field.name);
+            ok = false;
+        }
+    });
+    return ok;
 }
 
+enum SerialFormat {
+    serialText, // whitespace-separated values, in field order; hand-editable
+    serialBinary, // see BinaryHeader
+};
+
 template <typename T>
-static void saveToFile(const char* filename, T &item) {
+static void saveToFile(const char* filename, T &item,
+        SerialFormat format = serialText) {
+    if (format == serialBinary) {
+        BinaryWriter out(SerialFields<T>::version);
+        out.setRoot(writeRecord(out, item));
+        out.saveToFile(filename);
+        return;
+    }
     std::ofstream file;
     file.open(filename);
-    auto serial = serialize(item);
-    file << serial;
+    writeText(file, item);
     file.close();
 }
 
+/// @brief Loads either format, whichever the file's in
 template <typename T>
 static bool loadFromFile(const char* filename, T &item) {
+    if (isBinaryFile(filename)) {
+        BinaryFile file;
+        return file.open(filename) && readRecord(file.root(), item);
+    }
     std::ifstream file;
     file.open(filename);
     if (check(file.is_open(), "could not open file: %s", filename)) {
-        auto serial = serialize(item);
-        file >> serial;
+        readText(file, item);
         file.close();
         return true;
     }
@@ -89,3 +446,208 @@ static bool loadFromFile(const char* filename, T &item) {
 TEST(foo, {
     TEST_EQ_MSG(2+2, 4, "addition works");
 })
+
+#ifdef TESTING
+struct SerialTestPoint {
+    std::vector<int> tags; // so it's not trivially copyable
+    int x;
+};
+template <>
+struct SerialFields<SerialTestPoint> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("tags", &SerialTestPoint::tags),
+        serialField("x", &SerialTestPoint::x));
+};
+
+struct SerialTestItem {
+    int count = 0;
+    float scale = 0;
+    std::vector<float> values;
+    std::vector<SerialTestPoint> points;
+};
+template <>
+struct SerialFields<SerialTestItem> {
+    static constexpr Uint32 version = 2;
+    static constexpr auto fields = std::make_tuple(
+        serialField("count", &SerialTestItem::count),
+        serialField("scale", &SerialTestItem::scale),
+        serialField("values", &SerialTestItem::values),
+        serialField("points", &SerialTestItem::points));
+};
+
+// an older SerialTestItem, with fewer fields, in a different order
+struct SerialTestOld {
+    std::vector<float> values;
+    int count = 0;
+};
+template <>
+struct SerialFields<SerialTestOld> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("values", &SerialTestOld::values),
+        serialField("count", &SerialTestOld::count));
+};
+
+// could be copied whole, but the name belongs to whoever set it
+struct SerialTestNamed {
+    const char* name;
+    int hp;
+};
+template <>
+struct SerialFields<SerialTestNamed> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("hp", &SerialTestNamed::hp));
+};
+struct SerialTestParty {
+    SerialTestNamed leader;
+};
+template <>
+struct SerialFields<SerialTestParty> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("leader", &SerialTestParty::leader));
+};
+
+// trivially copyable, and saved by an older version with its members the
+// other way around
+struct SerialTestPos {
+    int x, y;
+};
+template <>
+struct SerialFields<SerialTestPos> {
+    static constexpr Uint32 version = 2;
+    static constexpr auto fields = std::make_tuple(
+        serialField("x", &SerialTestPos::x),
+        serialField("y", &SerialTestPos::y));
+};
+struct SerialTestPosOld {
+    int y, x;
+};
+template <>
+struct SerialFields<SerialTestPosOld> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("y", &SerialTestPosOld::y),
+        serialField("x", &SerialTestPosOld::x));
+};
+struct SerialTestPath {
+    std::vector<SerialTestPos> steps;
+};
+template <>
+struct SerialFields<SerialTestPath> {
+    static constexpr Uint32 version = 2;
+    static constexpr auto fields = std::make_tuple(
+        serialField("steps", &SerialTestPath::steps));
+};
+struct SerialTestPathOld {
+    std::vector<SerialTestPosOld> steps;
+};
+template <>
+struct SerialFields<SerialTestPathOld> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("steps", &SerialTestPathOld::steps));
+};
+#endif
+
+TEST(serializeBinary, {
+    SerialTestItem item {3, 1.5f, {1, 2, 3}, {{{1}, 4}, {{2, 3}, 5}}};
+    BinaryWriter out(SerialFields<SerialTestItem>::version);
+    out.setRoot(writeRecord(out, item));
+
+    BinaryFile file;
+    TEST_EQ_MSG(file.open(out.data().data(), out.data().size()), true,
+        "written file validates");
+    TEST_EQ(file.version(), 2u);
+    SerialTestItem loaded;
+    TEST_EQ(readRecord(file.root(), loaded), true);
+    TEST_EQ(loaded.count, 3);
+    TEST_EQ(loaded.scale, 1.5f);
+    TEST_EQ(loaded.values == item.values, true);
+    TEST_EQ(loaded.points.size(), 2u);
+    TEST_EQ_MSG(loaded.points[1].tags.size() == 2 && loaded.points[1].x == 5,
+        true, "nested records round trip");
+
+    int count;
+    const float* values = file.root().array<float>("values", &count);
+    const Uint8* start = out.data().data();
+    TEST_EQ_MSG((const Uint8*)values > start
+        && (const Uint8*)values < start + out.data().size(), true,
+        "arrays are read in place");
+    TEST_EQ(count, 3);
+    TEST_EQ(values[2], 3.0f);
+    TEST_EQ((Uint64)values % binaryAlign, 0u);
+    TEST_EQ_MSG(file.root().array<Uint16>("values", &count) == nullptr, true,
+        "arrays with a different element size don't load");
+
+    // a file without some fields leaves them alone
+    SerialTestOld old {{7}, 9};
+    BinaryWriter oldOut(SerialFields<SerialTestOld>::version);
+    oldOut.setRoot(writeRecord(oldOut, old));
+    file.open(oldOut.data().data(), oldOut.data().size());
+    SerialTestItem partial;
+    partial.scale = 7;
+    TEST_EQ(readRecord(file.root(), partial), true);
+    TEST_EQ(partial.count, 9);
+    TEST_EQ(partial.scale, 7.0f);
+    TEST_EQ(partial.values.size(), 1u);
+
+    // ...but one from a newer version doesn't load
+    file.open(out.data().data(), out.data().size());
+    TEST_EQ_MSG(readRecord(file.root(), old), false,
+        "newer versions don't load");
+
+    std::vector<Uint8> truncated(out.data().begin(), out.data().end() - 4);
+    TEST_EQ_MSG(file.open(truncated.data(), truncated.size()), false,
+        "truncated files don't validate");
+
+    // cut off partway through an array
+    file.open(out.data().data(), out.data().size());
+    Uint32 cut = file.root().find(fieldId("values"))->offset + 4;
+    std::vector<Uint8> cutArray(out.data().begin(), out.data().begin() + cut);
+    TEST_EQ_MSG(file.open(cutArray.data(), cutArray.size()), false,
+        "files cut off inside an array don't validate");
+})
+
+TEST(serializeListedFieldsOnly, {
+    SerialTestParty saved {{"saved", 12}};
+    BinaryWriter out(SerialFields<SerialTestParty>::version);
+    out.setRoot(writeRecord(out, saved));
+    BinaryFile file;
+    file.open(out.data().data(), out.data().size());
+    TEST_EQ(file.root().find(fieldId("leader"))->kind, binaryRecord);
+    SerialTestParty loaded {{"loaded", 0}};
+    TEST_EQ(readRecord(file.root(), loaded), true);
+    TEST_EQ(loaded.leader.hp, 12);
+    TEST_EQ_MSG(strcmp(loaded.leader.name, "loaded"), 0,
+        "fields that aren't listed aren't saved");
+})
+
+TEST(serializeReorderedVector, {
+    SerialTestPathOld old {{{2, 1}, {4, 3}}};
+    BinaryWriter out(SerialFields<SerialTestPathOld>::version);
+    out.setRoot(writeRecord(out, old));
+    BinaryFile file;
+    file.open(out.data().data(), out.data().size());
+    TEST_EQ(file.root().find(fieldId("steps"))->kind, binaryRecords);
+    SerialTestPath loaded;
+    TEST_EQ(readRecord(file.root(), loaded), true);
+    TEST_EQ(loaded.steps.size(), 2u);
+    TEST_EQ_MSG(loaded.steps[1].x == 3 && loaded.steps[1].y == 4, true,
+        "elements load by field name, not position");
+})
+
+TEST(serializeText, {
+    SerialTestItem item {3, 1.5f, {1, 2, 3}, {{{1}, 4}, {{2, 3}, 5}}};
+    std::stringstream text;
+    writeText(text, item);
+    SerialTestItem loaded;
+    readText(text, loaded);
+    TEST_EQ(loaded.count, 3);
+    TEST_EQ(loaded.scale, 1.5f);
+    TEST_EQ(loaded.values == item.values, true);
+    TEST_EQ_MSG(loaded.points.size() == 2 && loaded.points[1].tags.size() == 2
+        && loaded.points[1].x == 5, true, "nested fields round trip");
+})
@@ -0,0 +1,199 @@
+#include "spatialHash.h"
+
+#include <algorithm>
+
+/// @brief Strict overlap test, so rects that merely share an edge don't collide
+static bool overlaps(Rect const& a, Rect const& b) {
+    return a.pos.x < b.pos.x + b.size.x && b.pos.x < a.pos.x + a.size.x
+        && a.pos.y < b.pos.y + b.size.y && b.pos.y < a.pos.y + a.size.y;
+}
+
+float rayVsRect(Vec2 origin, Vec2 delta, Rect rect) {
+    float tEnter = 0;
+    float tExit = 1;
+    for (int i = 0; i < 2; ++i) {
+        float o = i == 0 ? origin.x : origin.y;
+        float d = i == 0 ? delta.x : delta.y;
+        float lo = i == 0 ? rect.pos.x : rect.pos.y;
+        float hi = lo + (i == 0 ? rect.size.x : rect.size.y);
+        if (d == 0) {
+            // parallel to this slab, so we're either always in it or never
+            if (o < lo || o > hi) {
+                return -1;
+            }
+            continue;
+        }
+        float t0 = (lo - o) / d;
+        float t1 = (hi - o) / d;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tEnter = max(tEnter, t0);
+        tExit = min(tExit, t1);
+        if (tEnter > tExit) {
+            return -1;
+        }
+    }
+    return tEnter;
+}
+
+SpatialHash::SpatialHash(float cellSize, int numBuckets) : _cellSize(cellSize) {
+    Uint32 n = 1;
+    while (n < (Uint32)numBuckets) {
+        n <<= 1;
+    }
+    _bucketMask = n-1;
+    _bucketStart.resize(n+1);
+}
+
+Uint32 SpatialHash::bucket(int cx, int cy) const {
+    // large primes from Teschner et al, "Optimized Spatial Hashing for
+    // Collision Detection of Deformable Objects"
+    return ((Uint32)cx * 73856093u ^ (Uint32)cy * 19349663u) & _bucketMask;
+}
+
+int SpatialHash::cellCoord(float v) const {
+    return (int)floor(v / _cellSize);
+}
+
+Uint32 SpatialHash::nextQueryId() const {
+    if (++_queryId == 0) {
+        // wrapped around; old stamps could look current, so clear them
+        std::fill(_stamps.begin(), _stamps.end(), 0);
+        _queryId = 1;
+    }
+    return _queryId;
+}
+
+void SpatialHash::build(const std::vector<Rect> &rects) {
+    build(rects.data(), rects.size());
+}
+
+void SpatialHash::build(const Rect* rects, int count) {
+    _rects.assign(rects, rects+count);
+    _stamps.assign(count, 0);
+    _queryId = 0;
+
+    // counting sort: first count how many entries land in each bucket...
+    std::fill(_bucketStart.begin(), _bucketStart.end(), 0);
+    for (auto &r : _rects) {
+        int x0 = cellCoord(r.pos.x), x1 = cellCoord(r.pos.x + r.size.x);
+        int y0 = cellCoord(r.pos.y), y1 = cellCoord(r.pos.y + r.size.y);
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                _bucketStart[bucket(cx, cy)+1]++;
+            }
+        }
+    }
+    // ...then prefix-sum the counts into starting offsets...
+    for (int b = 1; b < _bucketStart.size(); ++b) {
+        _bucketStart[b] += _bucketStart[b-1];
+    }
+    // ...then scatter each item into its slots
+    _items.resize(_bucketStart.back());
+    std::vector<int> cursor(_bucketStart.begin(), _bucketStart.end()-1);
+    for (int id = 0; id < count; ++id) {
+        auto &r = _rects[id];
+        int x0 = cellCoord(r.pos.x), x1 = cellCoord(r.pos.x + r.size.x);
+        int y0 = cellCoord(r.pos.y), y1 = cellCoord(r.pos.y + r.size.y);
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                _items[cursor[bucket(cx, cy)]++] = id;
+            }
+        }
+    }
+}
+
+int SpatialHash::size() const {
+    return _rects.size();
+}
+
+Rect SpatialHash::rect(int id) const {
+    return _rects[id];
+}
+
+void SpatialHash::query(Rect rect, std::vector<int> &out) const {
+    Uint32 stamp = nextQueryId();
+    int x0 = cellCoord(rect.pos.x), x1 = cellCoord(rect.pos.x + rect.size.x);
+    int y0 = cellCoord(rect.pos.y), y1 = cellCoord(rect.pos.y + rect.size.y);
+    for (int cy = y0; cy <= y1; ++cy) {
+        for (int cx = x0; cx <= x1; ++cx) {
+            Uint32 b = bucket(cx, cy);
+            for (int i = _bucketStart[b]; i < _bucketStart[b+1]; ++i) {
+                int id = _items[i];
+                if (_stamps[id] == stamp) {
+                    continue;
+                }
+                _stamps[id] = stamp;
+                if (overlaps(rect, _rects[id])) {
+                    out.push_back(id);
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::queryPairs(const std::vector<Rect> &others,
+        std::vector<Pair> &out) const {
+    std::vector<int> found;
+    for (int i = 0; i < others.size(); ++i) {
+        found.clear();
+        query(others[i], found);
+        for (int id : found) {
+            out.push_back({i, id});
+        }
+    }
+}
+
+bool SpatialHash::raycast(Vec2 origin, Vec2 delta, RayHit &hit) const {
+    // 2D DDA, from Amanatides & Woo, "A Fast Voxel Traversal Algorithm"
+    Uint32 stamp = nextQueryId();
+    int cx = cellCoord(origin.x);
+    int cy = cellCoord(origin.y);
+    int endX = cellCoord(origin.x + delta.x);
+    int endY = cellCoord(origin.y + delta.y);
+    int stepX = sign(delta.x);
+    int stepY = sign(delta.y);
+    const float inf = INFINITY;
+    // t at which we cross into the next column/row, and t per column/row
+    float tMaxX = stepX == 0 ? inf
+        : ((cx + (stepX > 0)) * _cellSize - origin.x) / delta.x;
+    float tMaxY = stepY == 0 ? inf
+        : ((cy + (stepY > 0)) * _cellSize - origin.y) / delta.y;
+    float tDeltaX = stepX == 0 ? inf : _cellSize / abs(delta.x);
+    float tDeltaY = stepY == 0 ? inf : _cellSize / abs(delta.y);
+
+    hit = {-1, 1};
+    while (true) {
+        Uint32 b = bucket(cx, cy);
+        for (int i = _bucketStart[b]; i < _bucketStart[b+1]; ++i) {
+            int id = _items[i];
+            if (_stamps[id] == stamp) {
+                continue;
+            }
+            _stamps[id] = stamp;
+            float t = rayVsRect(origin, delta, _rects[id]);
+            if (t >= 0 && (hit.item < 0 || t < hit.t)) {
+                hit = {id, t};
+            }
+        }
+
+        float tNext = min(tMaxX, tMaxY);
+        // anything hit before leaving this cell would've been in this cell or
+        // an earlier one, so nothing further along can beat it
+        if (hit.item >= 0 && hit.t <= tNext) {
+            break;
+        }
+        if ((cx == endX && cy == endY) || tNext > 1) {
+            break;
+        }
+        if (tMaxX < tMaxY) {
+            cx += stepX;
+            tMaxX += tDeltaX;
+        } else {
+            cy += stepY;
+            tMaxY += tDeltaY;
+        }
+    }
+    return hit.item >= 0;
+}
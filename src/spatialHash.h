@@ -0,0 +1,162 @@
+// SpatialHash - uniform-grid broadphase for overlap and ray queries
+
+#pragma once
+
+#include "bench.h"
+#include "common.h"
+#include "rng.h"
+#include "test.h"
+#include "vec.h"
+
+#include <vector>
+
+/// @brief Uniform grid of square cells, hashed down into a fixed number of
+/// buckets so the world doesn't need to be bounded. Meant to be rebuilt from
+/// scratch every frame: items get bucketed with a counting sort, so a rebuild
+/// is two linear passes with no per-cell allocations.
+class SpatialHash {
+    float _cellSize;
+    Uint32 _bucketMask; // number of buckets - 1; bucket count is a power of 2
+
+    std::vector<Rect> _rects; // bounds of each item, indexed by item id
+    // item ids sorted by bucket; bucket `b` owns [_bucketStart[b], _bucketStart[b+1])
+    std::vector<int> _bucketStart;
+    std::vector<int> _items;
+
+    // per-item stamps used to skip items we've already tested this query,
+    // since items spanning several cells are stored once per cell
+    mutable std::vector<Uint32> _stamps;
+    mutable Uint32 _queryId = 0;
+
+public:
+    /// @param cellSize width/height of each grid cell, ideally a bit bigger
+    /// than a typical item
+    /// @param numBuckets rounded up to a power of 2
+    SpatialHash(float cellSize = 64, int numBuckets = 4096);
+
+    /// @brief Replaces the contents of the hash; item ids are indices into `rects`
+    void build(const std::vector<Rect> &rects);
+    void build(const Rect* rects, int count);
+
+    int size() const;
+    Rect rect(int id) const;
+
+    /// @brief Finds every item whose bounds overlap `rect`
+    /// @param out item ids are appended to this, each at most once
+    void query(Rect rect, std::vector<int> &out) const;
+
+    struct Pair {
+        int other; // index into the `others` array
+        int item; // item id in the hash
+    };
+    /// @brief Overlap test for a batch of rects against the hash
+    /// @param out every overlapping (other, item) pair is appended to this
+    void queryPairs(const std::vector<Rect> &others, std::vector<Pair> &out) const;
+
+    struct RayHit {
+        int item;
+        float t; // fraction of the way along the ray, [0, 1]
+    };
+    /// @brief Finds the first item hit by the segment from `origin` to
+    /// `origin+delta`. Walks the grid cell-by-cell, so long rays only touch
+    /// the cells they actually cross
+    /// @return true iff anything was hit, in which case `hit` is filled out
+    bool raycast(Vec2 origin, Vec2 delta, RayHit &hit) const;
+
+private:
+    Uint32 bucket(int cx, int cy) const;
+    int cellCoord(float v) const;
+    Uint32 nextQueryId() const;
+};
+
+/// @brief Segment-vs-AABB slab test
+/// @return the fraction of `delta` at which the segment enters `rect`, 0 if
+/// `origin` starts inside it, or a negative number on a miss
+float rayVsRect(Vec2 origin, Vec2 delta, Rect rect);
+
+TEST(spatialHashQuery, {
+    SpatialHash hash(10, 16);
+    std::vector<Rect> rects {
+        {{0, 0}, {5, 5}},
+        {{-25, -25}, {40, 40}}, // spans lots of cells, including negative ones
+        {{100, 100}, {5, 5}},
+    };
+    hash.build(rects);
+    std::vector<int> found;
+    hash.query({{1, 1}, {2, 2}}, found);
+    TEST_EQ_MSG(found.size(), 2, "finds overlapping items exactly once");
+    found.clear();
+    hash.query({{50, 50}, {2, 2}}, found);
+    TEST_EQ_MSG(found.size(), 0, "hash collisions are filtered out");
+})
+
+TEST(spatialHashRaycast, {
+    SpatialHash hash(10, 16);
+    std::vector<Rect> rects {
+        {{50, -5}, {10, 10}},
+        {{20, -5}, {10, 10}},
+    };
+    hash.build(rects);
+    SpatialHash::RayHit hit;
+    TEST_EQ(hash.raycast({0, 0}, {100, 0}, hit), true);
+    TEST_EQ_MSG(hit.item, 1, "returns the closest hit");
+    TEST_EQ(hash.raycast({0, 0}, {-100, 0}, hit), false);
+    TEST_EQ_MSG(hash.raycast({0, 0}, {15, 0}, hit), false, "stops at segment end");
+})
+
+BENCH(spatialHash, {
+    // 10k bullets against 1k targets, spread over a 1080p screen
+    const int numBullets = 10'000;
+    const int numTargets = 1'000;
+    Rng rng;
+    rng.seed(1234);
+    std::vector<Rect> targets, bullets;
+    std::vector<Vec2> vels;
+    for (int i = 0; i < numTargets; ++i) {
+        targets.push_back({{rng.Float(1920), rng.Float(1080)}, {40, 60}});
+    }
+    for (int i = 0; i < numBullets; ++i) {
+        bullets.push_back({{rng.Float(1920), rng.Float(1080)}, {20, 20}});
+        vels.push_back(20.0f * Vec2::unit(rng.Float(TAU)));
+    }
+
+    const int iters = 20;
+    int naiveHits = 0;
+    BENCH_LOOP("naive pairs", iters, {
+        naiveHits = 0;
+        for (auto &b : bullets) {
+            for (auto &t : targets) {
+                naiveHits += b.pos.x < t.pos.x + t.size.x && t.pos.x < b.pos.x + b.size.x
+                    && b.pos.y < t.pos.y + t.size.y && t.pos.y < b.pos.y + b.size.y;
+            }
+        }
+        doNotOptimize(naiveHits);
+    });
+
+    SpatialHash hash;
+    BENCH_LOOP("hash rebuild", iters, {
+        hash.build(targets);
+    });
+
+    std::vector<SpatialHash::Pair> pairs;
+    BENCH_LOOP("hash rebuild + pairs", iters, {
+        pairs.clear();
+        hash.build(targets);
+        hash.queryPairs(bullets, pairs);
+        doNotOptimize(pairs);
+    });
+    check(pairs.size() == naiveHits, "hash found %d pairs, naive found %d",
+        (int)pairs.size(), naiveHits);
+
+    int rayHits = 0;
+    BENCH_LOOP("hash rebuild + rays", iters, {
+        rayHits = 0;
+        hash.build(targets);
+        SpatialHash::RayHit hit;
+        for (int i = 0; i < numBullets; ++i) {
+            rayHits += hash.raycast(bullets[i].pos, vels[i], hit);
+        }
+        doNotOptimize(rayHits);
+    });
+    printf("  pairs: %d, ray hits: %d\n", (int)pairs.size(), rayHits);
+})
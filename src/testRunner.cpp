@@ -3,12 +3,18 @@
 // the test app is always built with testing enabled
 #define TESTING
 
+#include "atlas.h"
 #include "builder.h"
+#include "damage.h"
+#include "format.h"
+#include "render_soft.h"
 #include "serialize.h"
+#include "spatialHash.h"
 
 #include <stdio.h>
 
 int main(int argc, char** argv) {
+    int failed = 0;
     for (auto &tc : gTestCases) {
         printf("test %s ... ", tc.name.c_str());
         auto result = tc.testFn();
@@ -16,7 +22,8 @@ int main(int argc, char** argv) {
             printf("pass\n");
         } else if (result.status == Failed) {
             printf("[FAILED]: %s\n", result.message.c_str());
+            failed++;
         }
     }
-    return 0;
+    return failed > 0 ? 1 : 0;
 }
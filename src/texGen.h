@@ -1,14 +1,18 @@
 #pragma once
 
+#include "bench.h"
 #include "color.h"
+#include "pixelWriter.h"
 #include "rng.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "serialize.h"
 #include "vec.h"
 
 #include <alloca.h>
 #include <fstream>
+#include <functional>
 #include <random>
+#include <sstream>
 
 #include <SDL2/SDL.h>
 
@@ -46,11 +50,27 @@ struct TexParams {
     float noiseAnimScale = 0;
     float tileAnimScale = 0;
 };
-Serialize<TexParams> serialize(TexParams &params);
+template <>
+struct SerialFields<TexParams> {
+    // 2: binary files store the gradient as a record, not a bare array
+    static constexpr Uint32 version = 2;
+    static constexpr auto fields = std::make_tuple(
+        serialField("seed", &TexParams::seed),
+        serialField("noiseSize", &TexParams::noiseSize),
+        serialField("numTextures", &TexParams::numTextures),
+        serialField("mode", &TexParams::mode),
+        serialField("noiseScale", &TexParams::noiseScale),
+        serialField("texSize", &TexParams::texSize),
+        serialField("gradient", &TexParams::gradient),
+        serialField("gradAnimScale", &TexParams::gradAnimScale),
+        serialField("noiseAnimScale", &TexParams::noiseAnimScale),
+        serialField("tileAnimScale", &TexParams::tileAnimScale));
+};
 
 class TexGen {
-    std::vector<SDL_Texture*> _textures;
+    std::vector<TextureHandle> _textures;
     std::vector<int> _texIndices;
+    Renderer* _renderer = nullptr; // what created `_textures`, to release them with
 
     Rng rng;
 
@@ -62,9 +82,7 @@ public:
     float tileAnimTime;
 
     ~TexGen() {
-        for (auto tex : _textures) {
-            SDL_DestroyTexture(tex);
-        }
+        freeTextures();
     }
 
     void seed() {
@@ -72,6 +90,15 @@ public:
     }
 
 private:
+    void freeTextures() {
+        // released rather than destroyed, so regenerating identical textures
+        // (e.g. after a reload) finds them still cached
+        for (auto &tex : _textures) {
+            _renderer->textures().release(tex);
+        }
+        _textures.clear();
+    }
+
     void generateNoise(NoiseSample* noise, int n) {
         for (int y = 0; y < n; ++y) {
             for (int x = 0; x < n; ++x) {
@@ -88,12 +115,12 @@ private:
         }
     }
 
-    SDL_Surface* generateSurface(NoiseSample* noise, int n, int texSize) {
-        const int bpp = 32;
-        SDL_Surface *surface = SDL_CreateRGBSurface(
-            0, texSize, texSize, bpp,
-            // RGBA bitmasks; A mask is special
-            0xff, 0xff << 8, 0xff << 16, 0);
+    SDL_Surface* generateSurface(Renderer* renderer, NoiseSample* noise, int n,
+            int texSize) {
+        // written in the renderer's own format, so uploading is just a copy
+        SDL_Surface *surface = renderer->createSurface(texSize, texSize);
+        PixelWriter pixels(surface, true);
+        pixels.fill(Color::black);
         Vec2f ntoi { float(texSize)/n, float(texSize)/n };
         Vec2f iton { float(n)/texSize, float(n)/texSize };
         // for each noise cell
@@ -164,31 +191,29 @@ private:
                         float b = smoothstep(uv.x, bl_s.v, br_s.v);
                         float c = smoothstep(uv.y, a, b);
                         // given 4 samples and a UV coordinate, interpolate
-                        Color *pixel = (Color*)((Uint8*)surface->pixels
-                            + j*surface->pitch
-                            + i*surface->format->BytesPerPixel);
+                        Color pixel;
                         if (texParams.mode == 0) {
-                            *pixel = ul_s.color;
+                            pixel = ul_s.color;
                         } else if (texParams.mode == 1) {
                             Color a = smoothstep(uv.x, ul_s.color, ur_s.color);
                             Color b = smoothstep(uv.x, bl_s.color, br_s.color);
-                            *pixel = smoothstep(uv.y, a, b);
+                            pixel = smoothstep(uv.y, a, b);
                         } else {
                             int cc = 0xff*(texParams.noiseScale*c);
                             if (texParams.mode == 2) {
-                                *pixel = {0, 0, 0, 0xff};
+                                pixel = {0, 0, 0, 0xff};
                                 // RGB cycles in 3s, value up/down cycles in 2s
                                 bool even = (cc % 0x200) < 0x100;
                                 cc = cc % 0x300;
                                 if (cc >= 0x200) {
                                     if (even) cc = 0xff - (cc%0x100);
-                                    pixel->g = cc % 0x100;
+                                    pixel.g = cc % 0x100;
                                 } else if (cc >= 0x100) {
                                     if (even) cc = 0xff - (cc%0x100);
-                                    pixel->r = cc % 0x100;
+                                    pixel.r = cc % 0x100;
                                 } else {
                                     if (even) cc = 0xff - (cc%0x100);
-                                    pixel->b = cc % 0x100;
+                                    pixel.b = cc % 0x100;
                                 }
                             } else if (texParams.mode == 3) {
                                 if ((cc/0x100) % 2 == 0) {
@@ -196,7 +221,7 @@ private:
                                 } else {
                                     cc %= 0x100;
                                 }
-                                *pixel = {Uint8(cc), Uint8(cc), Uint8(cc)};
+                                pixel = {Uint8(cc), Uint8(cc), Uint8(cc)};
                             } else if (texParams.mode == 4) {
                                 if ((cc/0x100) % 2 == 0) {
                                     cc = (0xff - cc%0x100);
@@ -204,15 +229,16 @@ private:
                                     cc %= 0x100;
                                 }
                                 const float r = 360.0f * (9/43.0f);
-                                *pixel = (cc/255.0f) * hsvColor(r*_textures.size(), 1, 1);
+                                pixel = (cc/255.0f) * hsvColor(r*_textures.size(), 1, 1);
                             } else if (texParams.mode == 5) {
                                 c = abs(fmod(c+gradAnimTime,2.0f)-1);
-                                *pixel = texParams.gradient.sample(c);
+                                pixel = texParams.gradient.sample(c);
                             } else {
                                 check(false, "invalid mode");
                                 return surface;
                             }
                         }
+                        pixels.set(i, j, pixel);
                     }
                 }
             }
@@ -227,10 +253,8 @@ public:
 
         rng.seed(texParams.seed);
 
-        for (auto tex : _textures) {
-            SDL_DestroyTexture(tex);
-        }
-        _textures.clear();
+        freeTextures();
+        _renderer = renderer;
         _texIndices.clear();
         // noise width/height
         int n = texParams.noiseSize;
@@ -269,9 +293,8 @@ public:
                 /* [0][y]   */ noise[j*n] = boundary[j*n];
                 /* [n-1][y] */ noise[j*n+n-1] = boundary[j*n+n-1];
             }
-            SDL_Surface *surface = generateSurface(noise, n, texParams.texSize);
-            auto sdl = renderer->sdl();
-            _textures.push_back(SDL_CreateTextureFromSurface(sdl, surface));
+            SDL_Surface *surface = generateSurface(renderer, noise, n, texParams.texSize);
+            _textures.push_back(renderer->textures().create(surface, "texgen"));
             SDL_FreeSurface(surface);
         }
 
@@ -297,7 +320,7 @@ public:
         texParams.seed = rng.Int();
     }
 
-    SDL_Texture* textureForIndex(int index) {
+    TextureHandle textureForIndex(int index) {
         // assert in case we get an underflowed `index` or something
         assert(_texIndices.size() < index+100'000,
             "don't generate more than 100,000 texture indices at a time pls");
@@ -318,3 +341,78 @@ public:
         }
     }
 };
+
+BENCH(serializeTexParams, {
+    const int count = 100'000;
+    std::vector<TexParams> items(count);
+    for (int i = 0; i < count; ++i) {
+        items[i].seed = i;
+        items[i].mode = i % 6;
+        items[i].gradient.steps.push_back({Color::red, 0.5f});
+    }
+
+    // both ways write about this much; room's made up front, so what's
+    // timed is walking the fields rather than growing the buffer
+    const size_t bytes = 400 * count;
+
+    // the old way: a list of type-erased fields built for every item, as
+    // Serialize<T> did. Writing binary through it, so only the field list
+    // differs from writeRecord
+    {
+        BinaryWriter out(0);
+        out.reserve(bytes);
+        BENCH_LOOP("std::function fields, binary (old)", count, {
+            TexParams &item = items[_bench_i];
+            std::vector<std::function<BinaryField (BinaryWriter&)>> fields;
+            auto add = [&](auto &field) {
+                fields.push_back([&](BinaryWriter &out) {
+                    return writeBinary(out, field);
+                });
+            };
+            add(item.seed);
+            add(item.noiseSize);
+            add(item.numTextures);
+            add(item.mode);
+            add(item.noiseScale);
+            add(item.texSize);
+            add(item.gradient);
+            add(item.gradAnimScale);
+            add(item.noiseAnimScale);
+            add(item.tileAnimScale);
+            Uint32 record = out.startRecord(fields.size(), 0);
+            for (int i = 0; i < fields.size(); ++i) {
+                out.setField(record, i, fields[i](out));
+            }
+        });
+        doNotOptimize(out.data().size());
+    }
+
+    std::vector<Uint32> records(count);
+    BinaryWriter out(SerialFields<TexParams>::version);
+    out.reserve(bytes);
+    BENCH_LOOP("SerialFields, binary write", count, {
+        records[_bench_i] = writeRecord(out, items[_bench_i]);
+    });
+    out.setRoot(records[0]);
+    BinaryFile file;
+    file.open(out.data().data(), out.data().size());
+    BinaryRecord root = file.root();
+    std::vector<TexParams> loaded(count);
+    BENCH_LOOP("SerialFields, binary read", count, {
+        readRecord(root.recordAt(records[_bench_i]), loaded[_bench_i]);
+    });
+    check(loaded[count-1].seed == count-1
+        && loaded[count-1].gradient.steps.size() == 3,
+        "binary round trip lost something");
+
+    std::stringstream text;
+    BENCH_LOOP("SerialFields, text write", count, {
+        writeText(text, items[_bench_i]);
+    });
+    BENCH_LOOP("SerialFields, text read", count, {
+        readText(text, loaded[_bench_i]);
+    });
+    check(loaded[count-1].seed == count-1, "text round trip lost something");
+    printf("  %.1fMB binary, %.1fMB text\n", out.data().size() / 1e6,
+        text.str().size() / 1e6);
+})
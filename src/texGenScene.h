@@ -4,8 +4,9 @@
 
 #include "color.h"
 #include "common.h"
+#include "fileWatcher.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
 #include "scene.h"
 #include "serialize.h"
 #include "texGen.h"
@@ -19,6 +20,8 @@
 class TexGenScene : public Scene {
     TexGen *_texGen;
     UI _ui;
+    FileWatcher* _fileWatcher;
+    int _saveFileId = -1; // from `_fileWatcher`, so edits on disk load
 
     int colorIdx = 0; // current gradient step index
 
@@ -26,17 +29,26 @@ class TexGenScene : public Scene {
     int renderSize = 1024; // NxN size of total display area on screen
     int gridSize = 16; // render an NxN grid of textures
 
-    bool _shouldGenerate;
+    bool _shouldGenerate = false;
+    // whether loadState ran, i.e. this is a reload
+    bool _restored = false;
+
+    friend struct SerialFields<TexGenScene>;
 
 public:
-    TexGenScene(TexGen *texGen, Allocator *alloc, Input *input) :
-            _texGen(texGen), _ui(alloc, input) {
+    TexGenScene(TexGen *texGen, Allocator *alloc, Input *input,
+            FileWatcher* fileWatcher) :
+            _texGen(texGen), _ui(alloc, input), _fileWatcher(fileWatcher) {
     }
 
     void onLoad() override {
-        _shouldGenerate = true; 
-
-        loadParams();
+        _saveFileId = _fileWatcher->watch(saveFile);
+        // the params live in the TexGen, which outlives reloads, as do the
+        // textures it made from them; only a fresh start needs either
+        if (!_restored) {
+            _shouldGenerate = true;
+            loadParams();
+        }
     }
 
     void onUnload() override {
@@ -45,9 +57,19 @@ public:
         saveParams();
     }
 
+    Uint32 saveState(BinaryWriter &out) const override {
+        return writeRecord(out, *this);
+    }
+    void loadState(const BinaryRecord &record) override {
+        _restored = readRecord(record, *this);
+    }
+
     const char* saveFile = "../data/texture.texParams";
     void saveParams() {
         saveToFile(saveFile, _texGen->texParams);
+        // our own write isn't an edit to load back
+        _fileWatcher->poll();
+        _fileWatcher->takeChange(_saveFileId);
         log("params saved to file");
     }
 
@@ -65,6 +87,10 @@ public:
         
         _ui.startUpdate({ 90, 30 });
 
+        if (_fileWatcher->takeChange(_saveFileId)) {
+            loadParams();
+        }
+
         _ui.align(180);
         if (_ui.button("reroll")) {
             _texGen->reroll();
@@ -196,3 +222,12 @@ public:
         _ui.render(renderer);
     }
 };
+
+template <>
+struct SerialFields<TexGenScene> {
+    static constexpr Uint32 version = 1;
+    static constexpr auto fields = std::make_tuple(
+        serialField("colorIdx", &TexGenScene::colorIdx),
+        serialField("renderSize", &TexGenScene::renderSize),
+        serialField("gridSize", &TexGenScene::gridSize));
+};
@@ -0,0 +1,320 @@
+#include "textureManager.h"
+
+#include "render.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+static Uint64 fnv1a(Uint64 hash, const void* data, size_t len) {
+    const Uint8* bytes = (const Uint8*)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// files and surfaces are hashed from different starting points, so a file
+// can't be mistaken for a surface whose pixels happen to spell its name
+static const Uint64 fileSeed = 14695981039346656037ull;
+static const Uint64 surfaceSeed = fileSeed ^ 0x5eed;
+
+static Uint64 hashSurface(SDL_Surface* surface) {
+    Uint64 hash = fnv1a(surfaceSeed, &surface->w, sizeof(surface->w));
+    hash = fnv1a(hash, &surface->h, sizeof(surface->h));
+    hash = fnv1a(hash, &surface->format->format, sizeof(surface->format->format));
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_LockSurface(surface);
+    }
+    // row by row, since padding at the end of each row could be anything
+    int rowBytes = surface->w * surface->format->BytesPerPixel;
+    for (int y = 0; y < surface->h; ++y) {
+        hash = fnv1a(hash, (Uint8*)surface->pixels + y*surface->pitch, rowBytes);
+    }
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+    return hash;
+}
+
+TextureHandle TextureManager::create(SDL_Surface* surface, const char* owner) {
+    Uint64 source = hashSurface(surface);
+    auto it = _bySource.find(source);
+    if (it != _bySource.end()) {
+        Vec2i size = _entries[it->second].size;
+        if (size.x == surface->w && size.y == surface->h) {
+            return addRef(it->second);
+        }
+    }
+    if (surface->w <= maxPackedSize && surface->h <= maxPackedSize) {
+        return pack(surface, source, owner);
+    }
+    Texture* texture = _renderer->createTexture(surface);
+    return insert(texture, -1, {0, 0}, {texture->w, texture->h}, source, owner);
+}
+
+TextureHandle TextureManager::load(const char* filename, const char* owner) {
+    Uint64 source = fnv1a(fileSeed, filename, strlen(filename));
+    auto it = _bySource.find(source);
+    if (it != _bySource.end()) {
+        return addRef(it->second);
+    }
+    Texture* texture = _renderer->loadTexture(filename);
+    if (!texture) {
+        log("failed to load texture %s: %s", filename, IMG_GetError());
+        return {};
+    }
+    return insert(texture, -1, {0, 0}, {texture->w, texture->h}, source, owner);
+}
+
+void TextureManager::release(TextureHandle& handle) {
+    Entry* entry = lookup(handle);
+    handle = {};
+    if (!entry) {
+        return;
+    }
+    check(entry->refs > 0, "releasing an unreferenced texture");
+    entry->refs--;
+}
+
+AtlasRegion TextureManager::get(TextureHandle handle) {
+    Entry* entry = lookup(handle);
+    if (!entry) {
+        return {nullptr, {}};
+    }
+    entry->lastUsedFrame = _frame;
+    return {entry->texture, entry->uv};
+}
+
+void TextureManager::setBudget(size_t bytes) {
+    _budget = bytes;
+}
+size_t TextureManager::totalBytes() const {
+    return _totalBytes;
+}
+
+void TextureManager::startFrame() {
+    _frame++;
+    if (_totalBytes <= _budget) {
+        return;
+    }
+    // either an unpacked texture, or a whole atlas page; evicting a single
+    // packed texture frees nothing while its page stays pinned
+    struct Victim {
+        Uint32 lastUsedFrame;
+        int page;
+        Uint32 index;
+    };
+    std::vector<Victim> victims;
+    std::vector<bool> pinned(_pages.size(), false);
+    std::vector<Uint32> pageLastUsed(_pages.size(), 0);
+    for (Uint32 i = 0; i < _entries.size(); ++i) {
+        auto& entry = _entries[i];
+        if (!entry.texture) {
+            continue;
+        }
+        bool cached = entry.refs == 0
+            && _frame - entry.lastUsedFrame > framesInFlight;
+        if (entry.page < 0) {
+            if (cached) {
+                victims.push_back({entry.lastUsedFrame, -1, i});
+            }
+            continue;
+        }
+        pinned[entry.page] = pinned[entry.page] || !cached;
+        pageLastUsed[entry.page] =
+            std::max(pageLastUsed[entry.page], entry.lastUsedFrame);
+    }
+    for (int i = 0; i < _pages.size(); ++i) {
+        if (_pages[i].texture && !pinned[i]) {
+            victims.push_back({pageLastUsed[i], i, 0});
+        }
+    }
+    std::sort(victims.begin(), victims.end(), [](Victim a, Victim b) {
+        return a.lastUsedFrame < b.lastUsedFrame;
+    });
+    for (auto& victim : victims) {
+        if (_totalBytes <= _budget) {
+            break;
+        }
+        if (victim.page < 0) {
+            evict(victim.index);
+        } else {
+            evictPage(victim.page);
+        }
+    }
+}
+
+void TextureManager::freeAll() {
+    for (Uint32 i = 0; i < _entries.size(); ++i) {
+        Entry& entry = _entries[i];
+        if (!entry.texture) {
+            continue;
+        }
+        check(entry.refs == 0, "texture from %s still has %d references",
+            entry.owner.c_str(), entry.refs);
+        evict(i);
+    }
+}
+
+void TextureManager::logReport() const {
+    struct OwnerTotals {
+        int count, cached;
+        size_t bytes, cachedBytes;
+    };
+    // sorted by name, so reports are easy to compare
+    std::map<std::string, OwnerTotals> owners;
+    int shared = 0;
+    for (auto& entry : _entries) {
+        if (!entry.texture) {
+            continue;
+        }
+        auto& totals = owners[entry.owner];
+        totals.count++;
+        totals.bytes += entry.bytes;
+        if (entry.refs == 0) {
+            totals.cached++;
+            totals.cachedBytes += entry.bytes;
+        }
+        shared += entry.refs > 1;
+    }
+    const float mb = 1024*1024;
+    log("texture memory: %.2f / %.2f MB budget", _totalBytes/mb, _budget/mb);
+    for (auto& it : owners) {
+        auto& t = it.second;
+        log("  %-12s %4d textures %8.2f MB  (%d cached, %.2f MB)",
+            it.first.c_str(), t.count, t.bytes/mb, t.cached, t.cachedBytes/mb);
+    }
+    int pages = 0;
+    float occupancy = 0;
+    for (auto& page : _pages) {
+        if (page.texture) {
+            pages++;
+            occupancy += page.packer.occupancy();
+        }
+    }
+    if (pages > 0) {
+        log("  %d atlas pages, %.2f MB, %.0f%% full", pages,
+            pages * (pageBytes / mb), 100 * occupancy / pages);
+    }
+    log("  %d created, %d requests shared an existing texture, %d currently "
+        "shared, %d evicted",
+        _counters.created, _counters.shared, shared, _counters.evicted);
+}
+
+TextureManager::Entry* TextureManager::lookup(TextureHandle handle) {
+    if (!handle || handle.slot > _entries.size()) {
+        return nullptr;
+    }
+    Entry* entry = &_entries[handle.slot - 1];
+    if (!entry->texture || entry->generation != handle.generation) {
+        return nullptr;
+    }
+    return entry;
+}
+
+TextureHandle TextureManager::addRef(Uint32 index) {
+    Entry& entry = _entries[index];
+    entry.refs++;
+    entry.lastUsedFrame = _frame;
+    _counters.shared++;
+    return {index + 1, entry.generation};
+}
+
+TextureHandle TextureManager::insert(Texture* texture, int page, Vec2i pos,
+        Vec2i size, Uint64 source, const char* owner) {
+    Uint32 index;
+    if (!_freeSlots.empty()) {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        index = _entries.size();
+        _entries.push_back({});
+    }
+    Entry& entry = _entries[index];
+    entry.texture = texture;
+    entry.page = page;
+    entry.pos = pos;
+    entry.size = size;
+    Vec2 texSize = Vec2i{texture->w, texture->h}.to<float>();
+    entry.uv = {pos.to<float>() / texSize, size.to<float>() / texSize};
+    entry.source = source;
+    entry.owner = owner;
+    // both backends keep 4 bytes per pixel
+    entry.bytes = size_t(size.x) * size.y * 4;
+    entry.refs = 1;
+    entry.lastUsedFrame = _frame;
+    _bySource[source] = index;
+    if (page < 0) {
+        _totalBytes += entry.bytes;
+    }
+    _counters.created++;
+    return {index + 1, entry.generation};
+}
+
+TextureHandle TextureManager::pack(SDL_Surface* surface, Uint64 source,
+        const char* owner) {
+    Vec2i size {surface->w, surface->h};
+    Vec2i padded = size + Vec2i{2*padding, 2*padding};
+    Vec2i pos;
+    int page = -1;
+    for (int i = 0; i < _pages.size() && page < 0; ++i) {
+        if (_pages[i].texture && _pages[i].packer.insert(padded, &pos)) {
+            page = i;
+        }
+    }
+    if (page < 0) {
+        // reuse a page slot that's been freed, if any
+        for (page = 0; page < _pages.size() && _pages[page].texture; ++page) {
+        }
+        if (page == _pages.size()) {
+            _pages.push_back({nullptr, AtlasPacker({pageSize, pageSize})});
+        }
+        // starts out transparent; the surface's pixels come zeroed
+        SDL_Surface* blank = _renderer->createSurface(pageSize, pageSize);
+        _pages[page].texture = _renderer->createTexture(blank);
+        SDL_FreeSurface(blank);
+        _totalBytes += pageBytes;
+        bool fits = _pages[page].packer.insert(padded, &pos);
+        assert(fits, "%dx%d doesn't fit on an empty atlas page", size.x, size.y);
+    }
+    pos += Vec2i{padding, padding};
+    Texture* texture = _pages[page].texture;
+    _renderer->updateTexture(texture, surface, pos);
+    return insert(texture, page, pos, size, source, owner);
+}
+
+void TextureManager::evict(Uint32 index) {
+    Entry& entry = _entries[index];
+    if (entry.page < 0) {
+        _renderer->destroyTexture(entry.texture);
+        _totalBytes -= entry.bytes;
+    } else {
+        AtlasPage& page = _pages[entry.page];
+        Vec2i pad {padding, padding};
+        page.packer.remove(entry.pos - pad, entry.size + 2*pad);
+        if (page.packer.count() == 0) {
+            _renderer->destroyTexture(page.texture);
+            page.texture = nullptr;
+            _totalBytes -= pageBytes;
+        }
+    }
+    auto it = _bySource.find(entry.source);
+    if (it != _bySource.end() && it->second == index) {
+        _bySource.erase(it);
+    }
+    _counters.evicted++;
+    entry.texture = nullptr;
+    entry.owner.clear();
+    // any handles still pointing here are now stale
+    entry.generation++;
+    _freeSlots.push_back(index);
+}
+
+void TextureManager::evictPage(int page) {
+    for (Uint32 i = 0; i < _entries.size() && _pages[page].texture; ++i) {
+        if (_entries[i].texture && _entries[i].page == page) {
+            evict(i);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+// textureManager.h - refcounted texture registry with a memory budget
+
+#pragma once
+
+#include "atlas.h"
+#include "common.h"
+#include "vec.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+class Renderer;
+struct Texture;
+
+/// @brief Refers to a texture in a TextureManager. Handles are plain values,
+/// so they survive game.dll reloads; a handle to a texture that's since been
+/// freed resolves to nullptr rather than whatever took its slot
+struct TextureHandle {
+    Uint32 slot = 0; // index + 1, so the default handle is null
+    Uint32 generation = 0;
+
+    explicit operator bool() const {
+        return slot != 0;
+    }
+    bool operator==(TextureHandle other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(TextureHandle other) const {
+        return !(*this == other);
+    }
+};
+
+/// @brief Where to find a texture's pixels: a whole texture, or part of an
+/// atlas page
+struct AtlasRegion {
+    Texture* texture; // null if there's nothing to draw
+    Rect uv; // normalized
+};
+
+/// @brief Hands out shared, refcounted textures. Asking for a texture that's
+/// already loaded (the same file, or a surface with identical pixels) returns
+/// the existing one instead of uploading it again.
+///
+/// Released textures aren't freed right away; they stay cached in case
+/// they're asked for again, and the least recently drawn ones get evicted
+/// once the total goes over budget. Textures still referenced never get
+/// evicted, so the budget can be exceeded if they alone add up to more.
+///
+/// Small surfaces get packed into shared atlas pages, so drawing several of
+/// them batches into a single draw call. Files (e.g. the font) always get a
+/// texture of their own. A page's memory only comes back once it's empty, so
+/// pages get evicted whole, and only when everything on them is evictable.
+///
+/// Owned by the Renderer, so it lives in the kernel and persists across
+/// reloads along with the textures themselves. Main thread only
+class TextureManager {
+    Renderer* _renderer;
+
+    struct Entry {
+        Texture* texture; // null when the slot is free; the page if packed
+        int page; // index into `_pages`, or -1 if it has its own texture
+        Vec2i pos, size; // in pixels, within the page if packed
+        Rect uv;
+        Uint32 generation;
+        Uint64 source; // hash of the filename or pixels it was made from
+        std::string owner; // copied, since game.dll's strings go away on reload
+        size_t bytes; // its own pixels; packed ones share their page's
+        int refs; // 0 means cached, and evictable
+        Uint32 lastUsedFrame;
+    };
+    std::vector<Entry> _entries;
+    std::vector<Uint32> _freeSlots;
+    std::unordered_map<Uint64, Uint32> _bySource; // to slot
+
+    struct AtlasPage {
+        Texture* texture; // null when the page isn't in use
+        AtlasPacker packer;
+    };
+    std::vector<AtlasPage> _pages;
+    static const int pageSize = 1024;
+    // anything bigger than this on either side gets a texture of its own
+    static const int maxPackedSize = 256;
+    // left empty around each packed texture, so filtering doesn't bleed
+    // neighbors into it
+    static const int padding = 1;
+    static const size_t pageBytes = size_t(pageSize) * pageSize * 4;
+    size_t _budget = 64 << 20;
+    // unpacked textures, plus every atlas page in use, whole
+    size_t _totalBytes = 0;
+    Uint32 _frame = 0;
+    // frames recorded but maybe not drawn yet; see Renderer's triple buffer
+    static const Uint32 framesInFlight = 3;
+
+    struct Counters {
+        int created;
+        int shared; // requests answered with an existing texture
+        int evicted;
+    } _counters {};
+
+public:
+    TextureManager(Renderer* renderer) : _renderer(renderer) {}
+
+    /// @brief Makes a texture from the surface's pixels, or adds a reference
+    /// to an identical one
+    /// @param owner who to attribute the memory to in reports, e.g. the scene
+    TextureHandle create(SDL_Surface* surface, const char* owner);
+    /// @brief Loads an image file, or adds a reference to it if it's loaded
+    /// @return a null handle if the file couldn't be loaded
+    TextureHandle load(const char* filename, const char* owner);
+    /// @brief Drops a reference, and nulls out the handle
+    void release(TextureHandle& handle);
+
+    /// @brief Looks up the texture for drawing, marking it as recently used
+    /// @return a null texture if the handle is null or stale
+    AtlasRegion get(TextureHandle handle);
+
+    /// @brief Sets the size cached textures get evicted down to
+    void setBudget(size_t bytes);
+    size_t totalBytes() const;
+
+    /// @brief Called by the Renderer before anything's drawn each frame. Skips
+    /// anything drawn in the last few frames, since the render thread may not
+    /// have gotten to them yet, and a freed atlas region can be overwritten
+    /// as soon as it's reused
+    void startFrame();
+    /// @brief Frees every cached texture, and complains about any that are
+    /// still referenced. The backend has to still be around for this
+    void freeAll();
+
+    /// @brief Logs texture memory by owner, for debugging
+    void logReport() const;
+
+private:
+    Entry* lookup(TextureHandle handle);
+    TextureHandle addRef(Uint32 index);
+    /// @param page -1 if the texture's its own, otherwise `texture` is the
+    /// page and `pos`/`size` are where in it
+    TextureHandle insert(Texture* texture, int page, Vec2i pos, Vec2i size,
+        Uint64 source, const char* owner);
+    /// @brief Uploads the surface into an atlas page, making a new page if
+    /// none have room
+    TextureHandle pack(SDL_Surface* surface, Uint64 source, const char* owner);
+    void evict(Uint32 index);
+    /// @brief Evicts everything packed into a page, which frees the page
+    void evictPage(int page);
+};
@@ -1,39 +1,14 @@
 #include "ui.h"
 
+#include "format.h"
+#include "profiler.h"
+
 #include <cstring>
 
-void UIButton::render(Renderer* renderer) {
-    if (isPressed && isHovered) {
-        renderer->setColor(0.25, 0.25, 0.25, 1.0);
-    } else if (isHovered) {
-        renderer->setColor(0.75, 0.75, 0.75, 1.0);
-    } else {
-        renderer->setColor(0.5, 0.5, 0.5, 1.0);
-    }
-    renderer->drawRect(pos, size);
-    renderer->drawText(label, pos + Vec2{5});
-}
-// static const size_t UILabel::maxLen = 31;
-void UILabel::render(Renderer* renderer) {
-    renderer->drawText(buffer, pos);
-}
-
-void UISlider::render(Renderer* renderer) {
-    Rect tab = tabRect();
-    float barH = 6;
-    renderer->setColor(0.3, 0.3, 0.3);
-    renderer->drawBox(pos + Vec2{tab.size.x, size.y-barH}/2, Vec2{size.x, barH});
-
-    if (isPressed) {
-        // set to pressed color regardless of if it's hovered, because
-        // click+drag on a slider updates when the mouse leaves the bounds
-        renderer->setColor(0.25, 0.25, 0.25, 1.0);
-    } else if (isHovered) {
-        renderer->setColor(0.75, 0.75, 0.75, 1.0);
-    } else {
-        renderer->setColor(0.5, 0.5, 0.5, 1.0);
-    }
-    renderer->drawRect(tab);
+Rect UISlider::hoverRect() const {
+    // add the tab size to the acceptable slider bounds
+    /// TODO: more accurate input handling means revisit this
+    return Rect { pos, size + Vec2{size.y, 0} };
 }
 
 Rect UISlider::tabRect() const {
@@ -43,123 +18,230 @@ Rect UISlider::tabRect() const {
     };
 }
 
-void UIRect::render(Renderer* renderer) {
-    renderer->setColor(color);
-    renderer->drawRect(pos, size);
-}
+static const Uint64 fnvSeed = 14695981039346656037ull;
 
-void UIElement::render(Renderer* renderer) {
-    switch (kind) {
-    case uiButton:
-        button.render(renderer);
-        break;
-    case uiLabel:
-        label.render(renderer);
-        break;
-    case uiSlider:
-        slider.render(renderer);
-        break;
-    case uiRect:
-        rect.render(renderer);
-        break;
+Uint64 UI::hashBytes(Uint64 hash, const void* data, size_t len) {
+    const Uint8* bytes = (const Uint8*)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
     }
+    return hash;
 }
 
-void UIElement::debugPrint() const {
-    // indented by two because we always call this from a UI
-    switch (kind) {
-    case uiButton:
-        log("  button label=\"%s\" pos=<%f, %f> size=<%f, %f>",
-            button.label,
-            button.pos.x, button.pos.y,
-            button.size.x, button.size.y);
-        break;
-    case uiLabel:
-        log("  label text=\"%s\" pos=<%f, %f> size=<%f, %f>",
-            label.buffer,
-            label.pos.x, label.pos.y,
-            label.size.x, label.size.y);
-        break;
-    case uiSlider:
-        log("  slider val=\"%f\" pos=<%f, %f> size=<%f, %f>",
-            slider.pct,
-            slider.pos.x, slider.pos.y,
-            slider.size.x, slider.size.y);
-        break;
-    default:
-        log("  [UNKNOWN]");
-        break;
+/// @brief Hashes a string and measures it in one pass
+/// @param len set to the string's length
+static Uint64 hashText(Uint64 hash, const char* text, int* len) {
+    const char* c = text;
+    for (; *c; ++c) {
+        hash = (hash ^ (Uint8)*c) * 1099511628211ull;
     }
+    *len = c - text;
+    return hash;
+}
+
+template <typename T>
+static void clearStore(UIStore<T> &store) {
+    store.elems.clear();
+    store.ids.clear();
+    store.lastFrame.clear();
+    store.declared.clear();
 }
 
 void UI::unload() {
-    _elements.clear();
+    clearStore(_buttons);
+    clearStore(_labels);
+    clearStore(_sliders);
+    clearStore(_rects);
+    _byId.clear();
+    _idStack.clear();
+    _repeats.clear();
+    _hitRects.clear();
+    _hitIds.clear();
+    _hitIndex.build(_hitRects);
+    _hovered = 0;
 }
 
 void UI::startUpdate(Vec2 pos) {
     _cursor = _origin = pos;
-    _elemIdx = 0;
     _lineHeight = 0;
+    buildHitIndex();
+    _buttons.declared.clear();
+    _labels.declared.clear();
+    _sliders.declared.clear();
+    _rects.declared.clear();
+    _repeats.clear();
+    _relayouts = 0;
+    _frame++;
+    if (_frame % staleFrames == 0) {
+        evictStale(_buttons);
+        evictStale(_labels);
+        evictStale(_sliders);
+        evictStale(_rects);
+    }
 }
 
 void UI::region(Vec2 pos) {
     _cursor = _origin = pos;
 }
 
+void UI::setLayer(int layer) {
+    _layer = layer;
+}
+
+void UI::buildHitIndex() {
+    _hitRects.clear();
+    _hitIds.clear();
+    for (int i : _buttons.declared) {
+        auto &button = _buttons.elems[i];
+        _hitRects.push_back({button.pos, button.size});
+        _hitIds.push_back(_buttons.ids[i]);
+    }
+    for (int i : _sliders.declared) {
+        _hitRects.push_back(_sliders.elems[i].hoverRect());
+        _hitIds.push_back(_sliders.ids[i]);
+    }
+    _hitIndex.build(_hitRects);
+    _hovered = hitTest(_input->getMousePos());
+}
+
+Uint64 UI::hitTest(Vec2 point) const {
+    std::vector<int> &found = _scratch;
+    found.clear();
+    _hitIndex.query({point, {0, 0}}, found);
+    // items are in draw order, so on overlaps the one on top wins
+    int top = -1;
+    for (int item : found) {
+        top = max(top, item);
+    }
+    return top >= 0 ? _hitIds[top] : 0;
+}
+
+bool UI::closestInteractable(Vec2 point, Vec2* center) const {
+    // widen the search until there's something in it. An item with its
+    // center within `radius` always overlaps the search square, so the
+    // nearest found is the nearest overall once it's that close
+    std::vector<int> &found = _scratch;
+    for (float radius = 32; radius < 8192; radius *= 2) {
+        found.clear();
+        _hitIndex.query({point - Vec2{radius}, Vec2{2*radius}}, found);
+        float bestDist2 = -1;
+        for (int item : found) {
+            Rect rect = _hitRects[item];
+            Vec2 c = rect.pos + rect.size/2;
+            float dist2 = (c - point).len2();
+            if (bestDist2 < 0 || dist2 < bestDist2) {
+                bestDist2 = dist2;
+                *center = c;
+            }
+        }
+        if (bestDist2 >= 0 && bestDist2 <= radius*radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void UI::render(Renderer* renderer) {
-    // draw a line to closest interactable UI element to the mouse
-    Vec2 mouse = _input->getMousePos();
+    ProfileScope profile("UI::render");
+    int prevLayer = renderer->setLayer(_layer);
+
+    // hover highlights follow the cursor as of now, rather than as of the
+    // last update, which can be most of a frame behind; clicks still go by
+    // what was hovered then
+    Vec2 mouse = _input->getCursorPos();
+    Uint64 hovered = hitTest(mouse);
+
+    // draw a line to closest interactable UI element to the mouse; this
+    // goes first so it renders beneath the actual UI
     Vec2 closest;
-    for (auto &elem : _elements) {
-        // Maybe<Rect> getInteractRect (or std::vector<Rect> for multi-thing widgets)
-        // could using Maybe = std::optional
-        Rect rect;
-        if (elem.kind == uiButton) {
-            rect = { elem.button.pos, elem.button.size };
-        } else if (elem.kind == uiSlider) {
-            rect = elem.slider.tabRect();
+    if (closestInteractable(mouse, &closest)) {
+        renderer->setColor(Color::red);
+        renderer->drawLine(mouse, closest);
+    }
+
+    // all the shapes, kind by kind...
+    for (int i : _rects.declared) {
+        auto &rect = _rects.elems[i];
+        renderer->setColor(rect.color);
+        renderer->drawRect(rect.pos, rect.size);
+    }
+    for (int i : _buttons.declared) {
+        auto &button = _buttons.elems[i];
+        bool isHovered = _buttons.ids[i] == hovered;
+        if (button.isPressed && isHovered) {
+            renderer->setColor(0.25, 0.25, 0.25, 1.0);
+        } else if (isHovered) {
+            renderer->setColor(0.75, 0.75, 0.75, 1.0);
         } else {
-            continue; // return {}
+            renderer->setColor(0.5, 0.5, 0.5, 1.0);
         }
-        Vec2 pos = rect.pos + rect.size/2;
+        renderer->drawRect(button.pos, button.size);
+    }
+    for (int i : _sliders.declared) {
+        auto &slider = _sliders.elems[i];
+        Rect tab = slider.tabRect();
+        float barH = 6;
+        renderer->setColor(0.3, 0.3, 0.3);
+        renderer->drawBox(slider.pos + Vec2{tab.size.x, slider.size.y-barH}/2,
+            Vec2{slider.size.x, barH});
 
-        // pick the closer one
-        if ((pos-mouse).len2() < (closest-mouse).len2()) {
-            closest = pos;
+        if (slider.isPressed) {
+            // set to pressed color regardless of if it's hovered, because
+            // click+drag on a slider updates when the mouse leaves the bounds
+            renderer->setColor(0.25, 0.25, 0.25, 1.0);
+        } else if (_sliders.ids[i] == hovered) {
+            renderer->setColor(0.75, 0.75, 0.75, 1.0);
+        } else {
+            renderer->setColor(0.5, 0.5, 0.5, 1.0);
         }
+        renderer->drawRect(tab);
     }
-    // draw this before the actual UI so it renders beneath it
-    renderer->setColor(Color::red);
-    renderer->drawLine(mouse, closest);
-
-    // only iterate up to _elemIdx, because we may have stale elems at the end
-    // of the array
-    for (int i = 0; i < _elemIdx; ++i) {
-        _elements[i].render(renderer);
+    // ...then all the text
+    for (int i : _buttons.declared) {
+        auto &button = _buttons.elems[i];
+        renderer->drawText(button.label, button.pos + Vec2{5});
+    }
+    for (int i : _labels.declared) {
+        auto &label = _labels.elems[i];
+        renderer->drawText(label.buffer, label.pos);
     }
+
+    renderer->setLayer(prevLayer);
 }
 
-bool UI::button(const char* label) {
-    UIElement &elem = nextElem();
-    if (elem.kind != uiButton) {
-        elem.kind = uiButton;
-        elem.button = UIButton();
+void UI::pushId(const char* name) {
+    Uint64 parent = _idStack.empty() ? fnvSeed : _idStack.back();
+    _idStack.push_back(hashBytes(parent, name, strlen(name)));
+}
+void UI::popId() {
+    check(!_idStack.empty(), "popId without a matching pushId");
+    if (!_idStack.empty()) {
+        _idStack.pop_back();
     }
-    UIButton &button = elem.button;
+}
+
+bool UI::button(const char* label, UISite site) {
+    bool created;
+    // the label's part of the id, so a found button has the same text, and
+    // the same size as last time
+    int index = element(_buttons, uiButton, widgetId(uiButton, site, label),
+        &created);
+    UIButton &button = _buttons.elems[index];
     button.label = label;
     button.pos = _cursor;
-    button.size = Renderer::fontSize * Vec2{(float)strlen(label), 1}
-        + _padding;
+    if (created) {
+        button.size = Renderer::fontSize * Vec2{(float)strlen(label), 1}
+            + _padding;
+    }
 
     _cursor.x += button.size.x + _padding.x;
     _lineHeight = max(_lineHeight, button.size.y);
 
-    Vec2 mouse = _input->getMousePos();
-    button.isHovered = in_rect(mouse, button);
+    button.isHovered = _buttons.ids[index] == _hovered;
     if (!button.isPressed) {
-        button.isPressed = button.isHovered && _input->didPress("click");
+        button.isPressed = button.isHovered && _input->didPress("click"_action);
         return false;
-    } else if (_input->didRelease("click")) {
+    } else if (_input->didRelease("click"_action)) {
         button.isPressed = false;
         // only count clicks if we release the click over this button
         return button.isHovered;
@@ -168,51 +250,103 @@ bool UI::button(const char* label) {
     }
 }
 
-void UI::label(const char* text) {
-    if (strcmp(text, "\n") == 0) {
+void UI::label(const char* text, UISite site) {
+    if (text[0] == '\n' && text[1] == '\0') {
         line();
         return;
     }
-    UIElement &elem = nextElem();
-    if (elem.kind != uiLabel) {
-        elem.kind = uiLabel;
-        elem.label = UILabel();
+    int len;
+    Uint64 hash = hashText(fnvSeed, text, &len);
+    UILabel* label;
+    if (labelChanged(site, labelText, hash, &label)) {
+        setLabelText(*label, text, len);
+    }
+    placeLabel(*label);
+}
+void UI::label(int num, UISite site) {
+    UILabel* label;
+    if (labelChanged(site, labelInt, (Uint32)num, &label)) {
+        char buffer[formatIntLen];
+        int len = formatInt(buffer, num);
+        setLabelText(*label, buffer, len);
+    }
+    placeLabel(*label);
+}
+void UI::label(float num, UISite site) {
+    Uint32 bits;
+    memcpy(&bits, &num, sizeof(bits));
+    UILabel* label;
+    if (labelChanged(site, labelFloat, bits, &label)) {
+        char buffer[formatFloatLen];
+        int len = formatFloat(buffer, num);
+        setLabelText(*label, buffer, len);
+    }
+    placeLabel(*label);
+}
+void UI::label(Vec2 v, UISite site) {
+    Uint32 bits[2];
+    memcpy(&bits[0], &v.x, sizeof(bits[0]));
+    memcpy(&bits[1], &v.y, sizeof(bits[1]));
+    UILabel* label;
+    if (labelChanged(site, labelVec2, (Uint64(bits[0]) << 32) | bits[1], &label)) {
+        char buffer[2*formatFloatLen + 4];
+        int len = 0;
+        buffer[len++] = '<';
+        len += formatFloat(buffer + len, v.x);
+        buffer[len++] = ',';
+        buffer[len++] = ' ';
+        len += formatFloat(buffer + len, v.y);
+        buffer[len++] = '>';
+        setLabelText(*label, buffer, len);
+    }
+    placeLabel(*label);
+}
+
+void UI::labelArg(UILabelArg arg) {
+    switch (arg.source) {
+    case labelText: label(arg.text, arg.site); break;
+    case labelInt: label(arg.i, arg.site); break;
+    case labelFloat: label(arg.v.x, arg.site); break;
+    case labelVec2: label(arg.v, arg.site); break;
+    }
+}
+
+bool UI::labelChanged(UISite site, UILabelSource source, Uint64 key,
+        UILabel** label) {
+    bool created;
+    int index = element(_labels, uiLabel, widgetId(uiLabel, site, nullptr),
+        &created);
+    *label = &_labels.elems[index];
+    if (!created && (*label)->source == source && (*label)->sourceKey == key) {
+        return false;
     }
-    UILabel &label = elem.label;
-    strncpy(label.buffer, text, UILabel::maxLen);
-    int len = min(strlen(text), UILabel::maxLen);
-    // UILabel::maxLen is 1 less than the buffer size, so we always have room
-    // for the terminal null byte
+    (*label)->source = source;
+    (*label)->sourceKey = key;
+    // new elements were already counted
+    _relayouts += !created;
+    return true;
+}
+
+void UI::setLabelText(UILabel &label, const char* text, int len) {
+    len = min(len, (int)UILabel::maxLen);
+    memcpy(label.buffer, text, len);
+    // UILabel::maxLen is 1 less than the buffer size, so we always have
+    // room for the terminal null byte
     label.buffer[len] = '\0';
-    label.pos = _cursor;
     label.size = Renderer::fontSize * Vec2{(float)len, 1};
+}
+
+void UI::placeLabel(UILabel &label) {
+    label.pos = _cursor;
 
     _cursor.x += label.size.x + _padding.x;
     _lineHeight = max(_lineHeight, label.size.y);
 }
-void UI::label(int num) {
-    char buffer[16];
-    sprintf(buffer, "%d", num);
-    label(buffer);
-}
-void UI::label(float num) {
-    char buffer[32];
-    sprintf(buffer, "%.2f", num);
-    label(buffer);
-}
-void UI::label(Vec2 v) {
-    char buffer[64];
-    sprintf(buffer, "<%.2f, %.2f>", v.x, v.y);
-    label(buffer);
-}
 
-void UI::rect(Color color, Vec2 size) {
-    UIElement &elem = nextElem();
-    if (elem.kind != uiRect) {
-        elem.kind = uiRect;
-        elem.rect = UIRect();
-    }
-    UIRect &rect = elem.rect;
+void UI::rect(Color color, Vec2 size, UISite site) {
+    bool created;
+    int index = element(_rects, uiRect, widgetId(uiRect, site, nullptr), &created);
+    UIRect &rect = _rects.elems[index];
     rect.pos = _cursor;
     rect.size = size;
     rect.color = color;
@@ -233,19 +367,52 @@ void UI::align(float x) {
 }
 
 void UI::debugPrint() const {
-    log("ui elems: %d", _elements.size());
-    for (auto &elem : _elements) {
-        elem.debugPrint();
+    // indented by two because we always call this from a UI
+    log("ui elems: %d", _buttons.elems.size() + _labels.elems.size()
+        + _sliders.elems.size() + _rects.elems.size());
+    for (auto &button : _buttons.elems) {
+        log("  button label=\"%s\" pos=<%f, %f> size=<%f, %f>",
+            button.label,
+            button.pos.x, button.pos.y,
+            button.size.x, button.size.y);
+    }
+    for (auto &label : _labels.elems) {
+        log("  label text=\"%s\" pos=<%f, %f> size=<%f, %f>",
+            label.buffer,
+            label.pos.x, label.pos.y,
+            label.size.x, label.size.y);
+    }
+    for (auto &slider : _sliders.elems) {
+        log("  slider val=\"%f\" pos=<%f, %f> size=<%f, %f>",
+            slider.pct,
+            slider.pos.x, slider.pos.y,
+            slider.size.x, slider.size.y);
+    }
+    for (auto &rect : _rects.elems) {
+        log("  rect pos=<%f, %f> size=<%f, %f>",
+            rect.pos.x, rect.pos.y,
+            rect.size.x, rect.size.y);
     }
 }
 
-UIElement& UI::nextElem() {
-    if (_elemIdx >= _elements.size()) {
-        // arbitrarily default to a label; could templatize this function later
-        _elements.emplace_back(UILabel());
+int UI::size() const {
+    return _buttons.declared.size() + _labels.declared.size()
+        + _sliders.declared.size() + _rects.declared.size();
+}
+
+int UI::relayouts() const {
+    return _relayouts;
+}
+
+Uint64 UI::widgetId(UIKind kind, UISite site, const char* label) const {
+    Uint64 hash = _idStack.empty() ? fnvSeed : _idStack.back();
+    hash = hashBytes(hash, &kind, sizeof(kind));
+    int len;
+    // by contents rather than address, which changes when game.dll reloads
+    hash = hashText(hash, site.file, &len);
+    hash = hashBytes(hash, &site.line, sizeof(site.line));
+    if (label) {
+        hash = hashText(hash, label, &len);
     }
-    // if the elem index is ever off by more than one, we've done something
-    // very wrong, and better to crash than allocate a billion slots
-    assert(_elemIdx < _elements.size(), "error managing _elemIdx");
-    return _elements[_elemIdx++];
+    return hash;
 }
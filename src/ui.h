@@ -1,11 +1,27 @@
 #pragma once
 
+#include "bench.h"
 #include "input_sdl.h"
-#include "render_sdl.h"
+#include "render.h"
+#include "spatialHash.h"
 #include "vec.h"
 
+#include <unordered_map>
 #include <vector>
 
+/// @brief Where a widget was declared in code. Defaults to the caller's file
+/// and line, which (along with a button's label) identifies a widget from one
+/// frame to the next no matter what comes before it
+struct UISite {
+    const char* file;
+    int line;
+
+    static UISite here(const char* file = __builtin_FILE(),
+            int line = __builtin_LINE()) {
+        return {file, line};
+    }
+};
+
 struct UIButton {
     const char* label = "";
     bool isHovered = false;
@@ -13,7 +29,13 @@ struct UIButton {
     Vec2 pos { 0, 0 };
     Vec2 size { 0, 0 };
 
-    void render(Renderer* renderer);
+};
+
+enum UILabelSource {
+    labelText,
+    labelInt,
+    labelFloat,
+    labelVec2,
 };
 
 struct UILabel {
@@ -21,8 +43,31 @@ struct UILabel {
     char buffer[maxLen+1];
     Vec2 pos { 0, 0 };
     Vec2 size { 0, 0 }; // bounding box
+    // what `buffer` was made from: a hash of the text, or the bits of the
+    // number(s) it was formatted from, so an unchanged value isn't formatted
+    // again
+    UILabelSource source = labelText;
+    Uint64 sourceKey = 0;
+};
 
-    void render(Renderer* renderer);
+/// @brief One argument to `UI::labels`. Converting to this is what picks up
+/// the caller's site, since a variadic template can't have a defaulted
+/// parameter after its pack
+struct UILabelArg {
+    UILabelSource source;
+    const char* text;
+    int i;
+    Vec2 v; // floats use x
+    UISite site;
+
+    UILabelArg(const char* text, UISite site = UISite::here())
+        : source(labelText), text(text), site(site) {}
+    UILabelArg(int i, UISite site = UISite::here())
+        : source(labelInt), i(i), site(site) {}
+    UILabelArg(float f, UISite site = UISite::here())
+        : source(labelFloat), v(f, 0), site(site) {}
+    UILabelArg(Vec2 v, UISite site = UISite::here())
+        : source(labelVec2), v(v), site(site) {}
 };
 
 struct UISlider {
@@ -31,8 +76,9 @@ struct UISlider {
     Vec2 size;
     bool isHovered, isPressed;
 
-    void render(Renderer* renderer);
-
+    /// @brief The area that counts as hovering it; the bar plus the overhang
+    /// of the tab at the far end
+    Rect hoverRect() const;
     /// @brief Get the rect that corresponds with the tab of the slider
     Rect tabRect() const;
 };
@@ -49,8 +95,6 @@ struct UIRect {
     Color color;
     Vec2 pos;
     Vec2 size;
-
-    void render(Renderer* renderer);
 };
 
 enum UIKind {
@@ -60,23 +104,27 @@ enum UIKind {
     uiRect,
 };
 
-struct UIElement {
-    UIKind kind;
-    union {
-        UIButton button;
-        UILabel label;
-        UISlider slider;
-        UIRect rect;
-    };
-
-    UIElement(UIButton _button) : kind(uiButton), button(_button) {}
-    UIElement(UILabel _label) : kind(uiLabel), label(_label) {}
-
-    void render(Renderer* renderer);
-
-    void debugPrint() const;
+/// @brief Every element of one kind, with their bookkeeping in parallel
+/// arrays, so drawing a kind walks one tightly packed array
+template <typename T>
+struct UIStore {
+    std::vector<T> elems;
+    std::vector<Uint64> ids;
+    std::vector<Uint32> lastFrame; // the last UI frame each was declared in
+    std::vector<int> declared; // indices declared this frame, in order
 };
 
+/// @brief Immediate-mode UI: widgets are declared every frame, and return
+/// whether they were interacted with. Behind that, elements are retained
+/// between frames, keyed by a hash of where they were declared (and, for
+/// buttons, their label), so adding or removing a widget doesn't shuffle the
+/// state of every one after it. Layout only gets recomputed for elements
+/// whose text changed.
+///
+/// Each kind of element is stored in its own array. Drawing goes kind by
+/// kind, all the shapes and then all the text, so the renderer gets two long
+/// runs of quads rather than alternating for every widget. Hovering is
+/// decided by one lookup in a spatial index of last frame's layout
 class UI {
     ///FIXME: we don't actually use or need this
     Allocator* _allocator;
@@ -86,10 +134,33 @@ class UI {
     Vec2 _origin; // starting point of cursor
     Vec2 _cursor; // current position to place an element
     float _lineHeight; // max height of elements on current line
-
-    std::vector<UIElement> _elements;
-    // index of the next element to use; reset to 0 each frame
-    int _elemIdx;
+    int _layer = layerUI; // what the renderer draws everything on
+
+    // every element we know of, including ones not declared this frame
+    UIStore<UIButton> _buttons;
+    UIStore<UILabel> _labels;
+    UIStore<UISlider> _sliders;
+    UIStore<UIRect> _rects;
+    struct UIRef {
+        UIKind kind;
+        int index; // into that kind's store
+    };
+    std::unordered_map<Uint64, UIRef> _byId;
+
+    // what can be hovered, as of the last frame's layout
+    SpatialHash _hitIndex {64, 256};
+    std::vector<Rect> _hitRects;
+    std::vector<Uint64> _hitIds;
+    Uint64 _hovered = 0; // id of the element under the mouse, if any
+    mutable std::vector<int> _scratch; // query results, kept to avoid reallocating
+    // ids of enclosing `pushId` scopes
+    std::vector<Uint64> _idStack;
+    // times each id's been repeated this frame
+    std::unordered_map<Uint64, int> _repeats;
+    Uint32 _frame = 0;
+    // elements not declared for this many frames get dropped
+    static const Uint32 staleFrames = 120;
+    int _relayouts = 0;
 public:
     UI(Allocator *allocator, Input* input)
         : _allocator(allocator), _input(input) {}
@@ -98,50 +169,57 @@ public:
     void startUpdate(Vec2 pos = {0, 0});
     void region(Vec2 pos);
     void render(Renderer* renderer);
+    /// @brief Sets the renderer layer elements get drawn on; layerUI by
+    /// default
+    void setLayer(int layer);
+
+    /// @brief Scopes the ids of widgets declared until the matching `popId`,
+    /// for helpers that declare the same widgets from the same place
+    /// several times, e.g. uiParam
+    void pushId(const char* name);
+    void popId();
 
     /// @brief creates a button at the cursor
     /// @param label text to display on the button
     /// @return true when clicked on
-    bool button(const char* label);
-
-    void label(const char* text);
-    void label(int num);
-    void label(float num);
-    void label(Vec2 v);
-    template <typename T, typename ...Ts>
-    void labels(T arg, Ts ...args) {
-        label(arg);
-        labels(args...);
+    bool button(const char* label, UISite site = UISite::here());
+
+    void label(const char* text, UISite site = UISite::here());
+    void label(int num, UISite site = UISite::here());
+    void label(float num, UISite site = UISite::here());
+    void label(Vec2 v, UISite site = UISite::here());
+    /// @brief A label per argument, e.g. `labels("HP: ", hp, "\n")`. They all
+    /// share the caller's site, and are told apart by order
+    template <typename ...Ts>
+    void labels(UILabelArg first, Ts ...rest) {
+        labelArg(first);
+        (labelArg(UILabelArg(rest, first.site)), ...);
     }
-    void labels() {} // base case for template recursion; nop
 
     /// @brief A slider the player can click and drag on to change a value
     /// @param val the value to change
     /// @param lo lower bound of the value
     /// @param hi upper bound of the value
     template <typename T>
-    void slider(T &val, T lo, T hi) {
-        UIElement &elem = nextElem();
-        if (elem.kind != uiSlider) {
-            elem.kind = uiSlider;
-            elem.slider = UISlider();
-        }
-        UISlider &slider = elem.slider;
+    void slider(T &val, T lo, T hi, UISite site = UISite::here()) {
+        bool created;
+        int index = element(_sliders, uiSlider,
+            widgetId(uiSlider, site, nullptr), &created);
+        UISlider &slider = _sliders.elems[index];
         slider.pos = _cursor;
-        slider.size = _padding + Vec2{200, 10};
+        if (created) {
+            slider.size = _padding + Vec2{200, 10};
+        }
 
         _cursor.x += slider.size.x + _padding.x;
         _lineHeight = max(_lineHeight, slider.size.y);
 
         Vec2 mouse = _input->getMousePos();
-        slider.isHovered = in_rect(mouse, slider.pos,
-            // add the tab size to the acceptable slider bounds
-            /// TODO: more accurate input handling means revisit this
-            slider.size+Vec2{slider.size.y,0});
+        slider.isHovered = _sliders.ids[index] == _hovered;
         // handle click
         if (!slider.isPressed) {
-            slider.isPressed = slider.isHovered && _input->didPress("click");
-        } else if (_input->didRelease("click")) {
+            slider.isPressed = slider.isHovered && _input->didPress("click"_action);
+        } else if (_input->didRelease("click"_action)) {
             slider.isPressed = false;
         }
         // handle drag
@@ -155,7 +233,7 @@ public:
         slider.pct = clamp(float(val-lo) / float(hi-lo));
     }
 
-    void rect(Color color, Vec2 size);
+    void rect(Color color, Vec2 size, UISite site = UISite::here());
 
 
     /// @brief Linebreak; moves cursor down to new line, resetting x position
@@ -167,8 +245,98 @@ public:
 
     void debugPrint() const;
 
+    /// @brief How many elements were declared last frame
+    int size() const;
+    /// @brief How many elements had their layout computed from scratch in the
+    /// last frame, rather than reusing last frame's
+    int relayouts() const;
+
 private:
-    /// @brief gets the next UIElement to update, grows the `_elements` array
-    /// by one if needed
-    UIElement& nextElem();
+    /// @param label hashed into the id if not null
+    Uint64 widgetId(UIKind kind, UISite site, const char* label) const;
+    /// @brief Finds the element with this id, or makes a new one. If one's
+    /// already been declared with it this frame (say, in a loop), the id gets
+    /// rehashed until it's unique, so repeats are told apart by order
+    /// @param created set to whether the element is new, and needs its
+    /// layout computed
+    /// @return its index in `store`
+    template <typename T>
+    int element(UIStore<T> &store, UIKind kind, Uint64 id, bool* created) {
+        auto it = _byId.find(id);
+        if (it != _byId.end() && store.lastFrame[it->second.index] == _frame) {
+            // the nth repeat gets the same id every frame, found in one step
+            // rather than by walking past the n-1 before it
+            int repeat = ++_repeats[id];
+            id = hashBytes(id, &repeat, sizeof(repeat));
+            it = _byId.find(id);
+        }
+        while (it != _byId.end() && (it->second.kind != kind
+                || store.lastFrame[it->second.index] == _frame)) {
+            // a genuine collision
+            const Uint8 bump = '+';
+            id = hashBytes(id, &bump, 1);
+            it = _byId.find(id);
+        }
+        int index;
+        *created = it == _byId.end();
+        if (*created) {
+            index = store.elems.size();
+            store.elems.emplace_back();
+            store.ids.push_back(id);
+            store.lastFrame.push_back(_frame);
+            _byId[id] = {kind, index};
+            _relayouts++;
+        } else {
+            index = it->second.index;
+            store.lastFrame[index] = _frame;
+        }
+        store.declared.push_back(index);
+        return index;
+    }
+
+    static Uint64 hashBytes(Uint64 hash, const void* data, size_t len);
+
+    void labelArg(UILabelArg arg);
+    /// @brief Finds or makes the label declared at `site`, and checks whether
+    /// its text needs to be made again
+    /// @param key identifies the value being shown; see `UILabel::sourceKey`
+    /// @param label set to the label
+    /// @return true if the text needs setting, because it's a new label or
+    /// the value changed
+    bool labelChanged(UISite site, UILabelSource source, Uint64 key,
+        UILabel** label);
+    void setLabelText(UILabel &label, const char* text, int len);
+    /// @brief Puts the label at the cursor, and moves the cursor past it
+    void placeLabel(UILabel &label);
+
+    /// @brief Drops elements that haven't been declared in a while
+    template <typename T>
+    void evictStale(UIStore<T> &store) {
+        for (int i = 0; i < store.elems.size();) {
+            if (_frame - store.lastFrame[i] <= staleFrames) {
+                ++i;
+                continue;
+            }
+            _byId.erase(store.ids[i]);
+            int last = store.elems.size()-1;
+            if (i != last) {
+                store.elems[i] = store.elems[last];
+                store.ids[i] = store.ids[last];
+                store.lastFrame[i] = store.lastFrame[last];
+                _byId[store.ids[i]].index = i;
+            }
+            store.elems.pop_back();
+            store.ids.pop_back();
+            store.lastFrame.pop_back();
+        }
+    }
+
+    /// @brief Rebuilds the hit index from what was declared last frame, and
+    /// finds what the mouse is over
+    void buildHitIndex();
+    /// @return the id of the topmost element under `point`, or 0
+    Uint64 hitTest(Vec2 point) const;
+    /// @brief Finds the interactable element whose center is nearest `point`
+    /// @return false if there aren't any
+    bool closestInteractable(Vec2 point, Vec2* center) const;
 };
@@ -0,0 +1,169 @@
+// uiBench.h - UI benchmarks. These need a concrete renderer, which game code
+// doesn't link, so they live apart from ui.h and only bench.exe includes them
+
+#pragma once
+
+#include "bench.h"
+#include "format.h"
+#include "profiler.h"
+#include "render_soft.h"
+#include "ui.h"
+
+BENCH(uiPanel, {
+    // a big debug panel: 5,000 widgets, an even mix of each kind, laid out
+    // in columns of rows
+    const int numWidgets = 5'000;
+    const int rowsPerColumn = 50;
+    Renderer_Soft renderer;
+    Input input;
+    input.addMouseBind("click", SDL_BUTTON_LEFT);
+    UI ui(nullptr, &input);
+    int values[numWidgets/4] = {};
+    auto declare = [&]() {
+        ui.startUpdate({10, 10});
+        for (int i = 0; i < numWidgets/4; ++i) {
+            if (i % rowsPerColumn == 0) {
+                ui.region({10 + 420.0f * (i / rowsPerColumn % 5), 10});
+            }
+            ui.rect(hsvColor(i*7 % 360, 0.8, 0.9), {20, 20});
+            ui.label("value");
+            ui.slider(values[i], 0, 100);
+            ui.button("reset");
+            ui.line();
+        }
+    };
+
+    const int iters = 100;
+    BENCH_LOOP("declare", iters, {
+        declare();
+    });
+    check(ui.size() == numWidgets, "declared %d widgets, expected %d",
+        ui.size(), numWidgets);
+    BENCH_LOOP("declare + render", iters, {
+        renderer.startFrame();
+        declare();
+        ui.render(&renderer);
+        renderer.endFrame();
+    });
+    // a full redraw, so the draw call count isn't hidden by damage tracking
+    renderer.invalidateAll();
+    renderer.startFrame();
+    declare();
+    ui.render(&renderer);
+    renderer.endFrame();
+    auto stats = renderer.stats();
+    printf("  %d draws recorded, in %d draw calls; %d relayouts\n",
+        stats.commands, stats.drawCalls, ui.relayouts());
+})
+
+BENCH(uiNumericLabels, {
+    // a wall of live stat readouts: 1,000 numeric labels, half ints and half
+    // floats
+    const int numLabels = 1'000;
+    Renderer_Soft renderer;
+    Input input;
+    input.addMouseBind("click", SDL_BUTTON_LEFT);
+    UI ui(nullptr, &input);
+    int frame = 0;
+    auto declare = [&](bool changing) {
+        ui.startUpdate({10, 10});
+        int t = changing ? frame++ : 0;
+        for (int i = 0; i < numLabels/2; ++i) {
+            if (i % 10 == 0) {
+                ui.line();
+            }
+            ui.label(i*1000 + t);
+            ui.label(i + t*0.01f);
+        }
+    };
+
+    const int iters = 200;
+    BENCH_LOOP("declare, values changing", iters, {
+        declare(true);
+    });
+    check(ui.relayouts() == numLabels, "%d labels changed, expected %d",
+        ui.relayouts(), numLabels);
+    declare(false);
+    BENCH_LOOP("declare, values unchanged", iters, {
+        declare(false);
+    });
+    check(ui.relayouts() == 0, "%d labels changed, expected none",
+        ui.relayouts());
+    BENCH_LOOP("declare + render, values changing", iters/4, {
+        renderer.startFrame();
+        declare(true);
+        ui.render(&renderer);
+        renderer.endFrame();
+    });
+
+    // the formatting on its own, against what it replaced
+    char buffer[formatFloatLen];
+    BENCH_LOOP("snprintf %d, %.2f", iters, {
+        for (int i = 0; i < numLabels/2; ++i) {
+            snprintf(buffer, sizeof(buffer), "%d", i*1000 + _bench_i);
+            doNotOptimize(buffer);
+            snprintf(buffer, sizeof(buffer), "%.2f", i + _bench_i*0.01f);
+            doNotOptimize(buffer);
+        }
+    });
+    BENCH_LOOP("formatInt, formatFloat", iters, {
+        for (int i = 0; i < numLabels/2; ++i) {
+            formatInt(buffer, i*1000 + _bench_i);
+            doNotOptimize(buffer);
+            formatFloat(buffer, i + _bench_i*0.01f);
+            doNotOptimize(buffer);
+        }
+    });
+})
+
+BENCH(profilerOverlay, {
+    // what the overlay adds to a frame, with a typical number of scenes and
+    // scopes to show
+    Renderer_Soft renderer;
+    Input input;
+    input.addMouseBind("click", SDL_BUTTON_LEFT);
+    Profiler profiler(nullptr, &input);
+    gProfiler = &profiler;
+    const char* scenes[] = {"texgen", "eyegen", "game", "rpg", "particles"};
+    const char* scopes[] = {"a", "b", "c", "d", "e", "f", "g", "h"};
+    auto frame = [&](int i) {
+        profiler.addSceneTime(scenes[i % 5], phaseUpdate, 1000);
+        profiler.addSceneTime(scenes[i % 5], phaseRender, 2000);
+        for (auto scope : scopes) {
+            ProfileScope profile(scope);
+        }
+    };
+
+    const int iters = 500;
+    profiler.toggle();
+    BENCH_LOOP("record + overlay", iters, {
+        renderer.startFrame();
+        frame(_bench_i);
+        profiler.render(&renderer);
+        profiler.endFrame(renderer.stats());
+    });
+    profiler.toggle();
+    BENCH_LOOP("record, overlay hidden", iters, {
+        renderer.startFrame();
+        frame(_bench_i);
+        profiler.render(&renderer);
+        profiler.endFrame(renderer.stats());
+    });
+
+    // the overlay times itself; that's the number it shows
+    profiler.toggle();
+    Uint64 ticks = 0;
+    for (int i = 0; i < iters; ++i) {
+        renderer.startFrame();
+        frame(i);
+        Uint64 start = SDL_GetPerformanceCounter();
+        profiler.render(&renderer);
+        ticks += SDL_GetPerformanceCounter() - start;
+        profiler.endFrame(renderer.stats());
+    }
+    double frameTicks = SDL_GetPerformanceFrequency() / 60.0;
+    float pct = 100 * ticks / iters / frameTicks;
+    printf("  overlay costs %.1f%% of a 60fps frame\n", pct);
+    check(pct < 2, "overlay costs %.1f%% of a frame, over budget", pct);
+    gProfiler = nullptr;
+})
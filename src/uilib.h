@@ -14,6 +14,8 @@ bool uiParam(UI &ui, const char* text, T &val, T delta, T lo, T hi) {
 }
 template <typename T>
 bool uiParam(UI &ui, const char* text, T &val, T dec, T inc, T lo, T hi) {
+    // every param declares the same widgets from here
+    ui.pushId(text);
     // right-align the labels :O
     ui.align(240-Renderer::fontSize.x*(strlen(text)+2));
     ui.labels(text, ":");
@@ -28,6 +30,7 @@ bool uiParam(UI &ui, const char* text, T &val, T dec, T inc, T lo, T hi) {
     ui.align(400);
     ui.slider(set, lo, hi);        
     ui.line();
+    ui.popId();
     if (set != val) {
         val = set;
         return true;
@@ -2,7 +2,7 @@
 
 # paths... hardcoded for now
 # and copy-pasted from build-scythe.sh... this is fine
-SDL2=../../SDL2-2.0.14/i686-w64-mingw32
+SDL2=../../SDL2-2.0.20/i686-w64-mingw32
 INCLUDE="-I${SDL2}/include"
 LIB="-L${SDL2}/lib"
 # FLAGS="-Wl,-subsystem,windows" # gets rid of the console window
@@ -20,7 +20,11 @@ cp -f $SDLBIN/SDL2_image.dll out/
 cp -f $SDLBIN/libpng16-16.dll out/
 cp -f $SDLBIN/zlib1.dll out/
 
-g++ -o out/testRunner src/testRunner.cpp ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
+# tests can exercise anything the headers they include declare, so link the
+# matching .cpp files too
+SRCS="src/common.cpp src/vec.cpp src/spatialHash.cpp src/damage.cpp src/atlas.cpp src/format.cpp src/serialize.cpp src/color.cpp src/render.cpp src/render_soft.cpp src/textureManager.cpp"
+
+g++ -o out/testRunner src/testRunner.cpp ${SRCS} ${INCLUDE} ${LIB} ${FLAGS} ${LINK} ${DBG_FLAGS}
 
 pushd out
 ./testRunner